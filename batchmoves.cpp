@@ -0,0 +1,275 @@
+//
+// Moves applied to many boards at once.  See batchmoves.h.
+//
+// Each line is slid in three steps that make the same decisions for every board, so
+// that the boards can share instructions: close the gaps, combine equal neighbours
+// from the front, then close the gaps the combined tiles left.  Closing the gaps is a
+// bubble pass repeated until no tile moves, at most N-1 times.
+//
+#include "batchmoves.h"
+#include "threadpool.h"
+
+#if defined( __x86_64__) || defined( __i386__)
+#include <immintrin.h>       // AVX2 intrinsics
+#define BATCH_AVX2 1
+#define AVX2_TARGET __attribute__(( target( "avx2")))
+#endif
+
+
+// One line of BatchLanes boards: line[ j][ lane] is square j of the line on that board
+typedef int BatchLine[ MaxBoardSize][ BatchLanes];
+
+
+//--------------------------------------------------------------------
+// Move the tiles of a line of every board toward line[ 0], closing the gaps
+template <int N>
+inline void compactLanes( BatchLine line)
+{
+    for( int pass=1; pass<N; pass++) {
+        int moved = 0;
+        for( int i=0; i<N-1; i++) {
+            for( int lane=0; lane<BatchLanes; lane++) {
+                int next = line[ i+1][ lane];
+                bool hole = (line[ i][ lane] == 0);
+                moved |= hole ? next : 0;
+                line[ i][ lane] = hole ? next : line[ i][ lane];
+                line[ i+1][ lane] = hole ? 0 : next;
+            }
+        }
+        if( moved == 0) {
+            break;
+        }
+    }
+}
+
+
+// Combine equal neighbours of a closed-up line from the front, adding each board's
+// points to score.  A pair of empty squares adds nothing, and a square emptied by
+// combining cannot match the tile after it, so no tile combines twice.
+template <int N>
+inline void mergeLanes( BatchLine line, int score[])
+{
+    for( int i=0; i<N-1; i++) {
+        for( int lane=0; lane<BatchLanes; lane++) {
+            int pair = (line[ i][ lane] == line[ i+1][ lane]) ? line[ i][ lane] : 0;
+            line[ i][ lane] += pair;
+            line[ i+1][ lane] -= pair;
+            score[ lane] += pair + pair;
+        }
+    }
+}
+
+
+// Slide one line of BatchLanes boards.  Square j of the line on board lane is
+// pIn[ j*lineStep + lane], and goes to the same place in pOut, which may be pIn.
+// Each board's points are added to score, and changed is set for boards that moved.
+template <int N>
+void slideLanes( const int *pIn, int *pOut, int lineStep, int score[], int changed[])
+{
+    BatchLine line;
+    for( int j=0; j<N; j++) {
+        for( int lane=0; lane<BatchLanes; lane++) {
+            line[ j][ lane] = pIn[ j*lineStep + lane];
+        }
+    }
+    compactLanes<N>( line);
+    mergeLanes<N>( line, score);
+    compactLanes<N>( line);
+    for( int j=0; j<N; j++) {
+        for( int lane=0; lane<BatchLanes; lane++) {
+            changed[ lane] |= (line[ j][ lane] != pIn[ j*lineStep + lane]);
+            pOut[ j*lineStep + lane] = line[ j][ lane];
+        }
+    }
+}
+
+
+#ifdef BATCH_AVX2
+// The same steps with one register per square of the line
+template <int N>
+AVX2_TARGET inline void compactAvx2( __m256i v[])
+{
+    const __m256i zero = _mm256_setzero_si256();
+    for( int pass=1; pass<N; pass++) {
+        __m256i moved = zero;
+        for( int i=0; i<N-1; i++) {
+            __m256i hole = _mm256_cmpeq_epi32( v[ i], zero);
+            moved = _mm256_or_si256( moved, _mm256_and_si256( hole, v[ i+1]));
+            v[ i] = _mm256_blendv_epi8( v[ i], v[ i+1], hole);
+            v[ i+1] = _mm256_andnot_si256( hole, v[ i+1]);
+        }
+        if( _mm256_testz_si256( moved, moved)) {
+            break;
+        }
+    }
+}
+
+
+template <int N>
+AVX2_TARGET void slideLanesAvx2( const int *pIn, int *pOut, int lineStep, int score[], int changed[])
+{
+    __m256i v[ N];
+    for( int j=0; j<N; j++) {
+        v[ j] = _mm256_loadu_si256( (const __m256i *)(pIn + j*lineStep));
+    }
+    compactAvx2<N>( v);
+    __m256i points = _mm256_loadu_si256( (const __m256i *)score);
+    for( int i=0; i<N-1; i++) {
+        __m256i pair = _mm256_and_si256( _mm256_cmpeq_epi32( v[ i], v[ i+1]), v[ i]);
+        v[ i] = _mm256_add_epi32( v[ i], pair);
+        v[ i+1] = _mm256_sub_epi32( v[ i+1], pair);
+        points = _mm256_add_epi32( points, _mm256_add_epi32( pair, pair));
+    }
+    _mm256_storeu_si256( (__m256i *)score, points);
+    compactAvx2<N>( v);
+    __m256i differ = _mm256_loadu_si256( (const __m256i *)changed);
+    for( int j=0; j<N; j++) {
+        __m256i before = _mm256_loadu_si256( (const __m256i *)(pIn + j*lineStep));
+        differ = _mm256_or_si256( differ, _mm256_xor_si256( before, v[ j]));
+        _mm256_storeu_si256( (__m256i *)(pOut + j*lineStep), v[ j]);
+    }
+    _mm256_storeu_si256( (__m256i *)changed, differ);
+}
+#endif
+
+
+//--------------------------------------------------------------------
+// First square and step between squares of line k, sliding toward its first square
+static void lineGeometry( char direction, int k, int N, int &start, int &step)
+{
+    switch( direction) {
+        case 'w': start = k;             step = N;  break;
+        case 's': start = (N-1)*N + k;   step = -N; break;
+        case 'd': start = k*N + N-1;     step = -1; break;
+        default:  start = k*N;           step = 1;  break;
+    }
+}
+
+
+typedef void (*LanesKernel)( const int *pIn, int *pOut, int lineStep, int score[], int changed[]);
+
+// Slide every line of BatchLanes boards stored count apart, starting at pIn and pOut
+template <int N, LanesKernel Kernel>
+inline void moveLanes( const int *pIn, int *pOut, int count, char direction, int score[], int changed[])
+{
+    for( int k=0; k<N; k++) {
+        int start, step;
+        lineGeometry( direction, k, N, start, step);
+        Kernel( pIn + start*count, pOut + start*count, step*count, score, changed);
+    }
+}
+
+
+// Move boards first up to last, BatchLanes at a time.  The boards past the last whole
+// group are copied into a padded group of their own.
+template <int N, LanesKernel Kernel>
+void moveRange( const BoardBatch &boards, char direction, BoardBatch &moved, int first, int last)
+{
+    int count = boards.count;
+    for( int b0=first; b0<last; b0+=BatchLanes) {
+        int lanes = (last - b0 < BatchLanes) ? last - b0 : BatchLanes;
+        int score[ BatchLanes] = { 0 };
+        int changed[ BatchLanes] = { 0 };
+        if( lanes == BatchLanes) {
+            moveLanes<N, Kernel>( &boards.squares[ b0], &moved.squares[ b0], count, direction, score, changed);
+        }
+        else {
+            int group[ N*N*BatchLanes];
+            for( int i=0; i<N*N; i++) {
+                for( int lane=0; lane<BatchLanes; lane++) {
+                    group[ i*BatchLanes + lane] = (lane < lanes) ? boards.squares[ i*count + b0 + lane] : 0;
+                }
+            }
+            moveLanes<N, Kernel>( group, group, BatchLanes, direction, score, changed);
+            for( int i=0; i<N*N; i++) {
+                for( int lane=0; lane<lanes; lane++) {
+                    moved.squares[ i*count + b0 + lane] = group[ i*BatchLanes + lane];
+                }
+            }
+        }
+        for( int lane=0; lane<lanes; lane++) {
+            moved.scores[ b0 + lane] = score[ lane];
+            moved.changed[ b0 + lane] = (unsigned char)(changed[ lane] != 0);
+        }
+    }
+}
+
+
+template <int N>
+void moveRangeFor( const BoardBatch &boards, char direction, BoardBatch &moved, int first, int last, bool avx2)
+{
+#ifdef BATCH_AVX2
+    if( avx2) {
+        moveRange<N, slideLanesAvx2<N> >( boards, direction, moved, first, last);
+        return;
+    }
+#endif
+    (void)avx2;
+    moveRange<N, slideLanes<N> >( boards, direction, moved, first, last);
+}
+
+
+static void moveBoards( const BoardBatch &boards, char direction, BoardBatch &moved, int first, int last, bool avx2)
+{
+    switch( boards.squaresPerSide) {
+        case 4:  moveRangeFor<4>( boards, direction, moved, first, last, avx2);   break;
+        case 5:  moveRangeFor<5>( boards, direction, moved, first, last, avx2);   break;
+        case 6:  moveRangeFor<6>( boards, direction, moved, first, last, avx2);   break;
+        case 7:  moveRangeFor<7>( boards, direction, moved, first, last, avx2);   break;
+        case 8:  moveRangeFor<8>( boards, direction, moved, first, last, avx2);   break;
+        case 9:  moveRangeFor<9>( boards, direction, moved, first, last, avx2);   break;
+        case 10: moveRangeFor<10>( boards, direction, moved, first, last, avx2);  break;
+        case 11: moveRangeFor<11>( boards, direction, moved, first, last, avx2);  break;
+        case 12: moveRangeFor<12>( boards, direction, moved, first, last, avx2);  break;
+    }
+}
+
+
+//--------------------------------------------------------------------
+void batchResize( BoardBatch &batch, int squaresPerSide, int count)
+{
+    batch.squaresPerSide = squaresPerSide;
+    batch.count = count;
+    batch.squares.assign( squaresPerSide * squaresPerSide * count, 0);
+    batch.scores.assign( count, 0);
+    batch.changed.assign( count, 0);
+}
+
+
+void batchSetBoard( BoardBatch &batch, int b, const int board[])
+{
+    for( int i=0; i<batch.squaresPerSide * batch.squaresPerSide; i++) {
+        batch.squares[ i * batch.count + b] = board[ i];
+    }
+}
+
+
+void batchGetBoard( const BoardBatch &batch, int b, int board[])
+{
+    for( int i=0; i<batch.squaresPerSide * batch.squaresPerSide; i++) {
+        board[ i] = batch.squares[ i * batch.count + b];
+    }
+}
+
+
+void batchMove( const BoardBatch &boards, char direction, BoardBatch &moved, ThreadPool *pPool, SimdLevel level)
+{
+    if( &moved != &boards) {
+        if( moved.squares.size() != boards.squares.size() || moved.scores.size() != boards.scores.size()) {
+            batchResize( moved, boards.squaresPerSide, boards.count);
+        }
+        moved.squaresPerSide = boards.squaresPerSide;
+        moved.count = boards.count;
+    }
+    bool avx2 = (level >= SimdAvx2 && simdSupported() >= SimdAvx2);
+    int chunks = (boards.count + BatchChunk - 1) / BatchChunk;
+    if( pPool == NULL || chunks < 2) {
+        moveBoards( boards, direction, moved, 0, boards.count, avx2);
+        return;
+    }
+    pPool->parallelFor( chunks, [&]( int chunk) {
+        int first = chunk * BatchChunk;
+        int last = (first + BatchChunk < boards.count) ? first + BatchChunk : boards.count;
+        moveBoards( boards, direction, moved, first, last, avx2);
+    });
+}
@@ -0,0 +1,50 @@
+//
+// Moves applied to many boards at once.
+//
+// A BoardBatch holds boards of one size as a structure of arrays: square i of board b
+// is squares[ i*count + b], so the same square of neighbouring boards is contiguous
+// and one vector register holds it for eight boards.  batchMove slides every board in
+// the same direction, working on eight boards per instruction rather than within one
+// board, and gives each board's new squares, the points it made and whether it
+// changed.  The merge rules are those of Left1: each tile combines at most once, so
+// 2 2 4 4  becomes  4 8 0 0.
+//
+#ifndef BATCHMOVES_H
+#define BATCHMOVES_H
+
+#include <cstddef>           // For NULL
+#include <vector>
+#include "simdrows.h"
+
+class ThreadPool;
+
+
+const int BatchLanes = 8;       // boards moved together, the int lanes of an AVX2 register
+const int BatchChunk = 1024;    // boards per task when a pool is given
+
+
+struct BoardBatch
+{
+    int squaresPerSide;
+    int count;                            // boards in the batch
+    std::vector<int> squares;             // square i of board b at [ i*count + b]
+    std::vector<int> scores;              // points made by each board in the last batchMove
+    std::vector<unsigned char> changed;   // 1 if the last batchMove changed board b
+};
+
+
+// Make room for count boards of the given size, all empty
+void batchResize( BoardBatch &batch, int squaresPerSide, int count);
+
+// Copy board b in or out of the batch, as an ordinary int[] board
+void batchSetBoard( BoardBatch &batch, int b, const int board[]);
+void batchGetBoard( const BoardBatch &batch, int b, int board[]);
+
+// Slide every board in boards in direction 'w', 'a', 's' or 'd', putting the new boards,
+// scores and changed flags in moved, which is resized to match or may be boards itself.
+// The boards are split among the pool's threads if pPool is not NULL.  The AVX2 kernel
+// is used when the CPU has it and level allows it; otherwise plain loops over the boards.
+void batchMove( const BoardBatch &boards, char direction, BoardBatch &moved,
+                ThreadPool *pPool = NULL, SimdLevel level = SimdAvx2);
+
+#endif
@@ -0,0 +1,579 @@
+//
+// Microbenchmarks for the 1024 engine.
+//
+// For every board size from 4 to 12, times the engine primitives over fixed corpora of
+// seeded positions: each of the four moves (the generic int[] loops in game.cpp, the
+// size-specialized kernels in boardkernels.h, the SSE4.1 and AVX2 row kernels on the
+// larger boards when the CPU has them, the bitboard engine, and batchMove on the whole
+// corpus at once), Random1, gameEnds and gameStatus, legalMoves, duplicate and Board1,
+// packed board keys, the undo history, restarting the background hint search, and whole
+// games played by the random policy.  Results are printed as a table, or as CSV or JSON
+// so that runs from different builds and machines can be compared.
+//
+// It also checks that the specialized, vector and batch kernels give the same boards and
+// scores as the generic loops, and report the combined tiles, changed boards and legal
+// moves correctly, that the tile motions of traced moves account for every tile, checks
+// the board keys and their symmetries, and exits with 1 if any of these fail.
+//
+// To build and run:
+//    cmake -S . -B build && cmake --build build --target bench
+//    ./build/bench [--seconds S] [--format table|csv|json] [--sizes 4-12]
+//
+#include <iostream>          // For cout, cerr, endl
+#include <iomanip>           // used for setting output field size using setw
+#include <sstream>           // For ostringstream, where gameEnds' messages are sent
+#include <cstdlib>           // For atof()
+#include <cstdio>            // For sprintf, sscanf
+#include <cstring>           // For memcpy(), strcmp()
+#include <chrono>            // For steady_clock
+#include <string>
+#include <thread>            // For this_thread::sleep_for()
+#include <vector>
+#include "game.h"
+#include "rng.h"
+#include "bitboard.h"
+#include "boardkernels.h"
+#include "simdrows.h"
+#include "history.h"
+#include "policy.h"
+#include "simulate.h"
+#include "batchmoves.h"
+#include "boardkey.h"
+#include "hint.h"
+using namespace std;
+
+
+const int CorpusSize = 4096;   // positions per board size
+const int CorpusSeed = 1000;   // the corpus for size n is seeded with CorpusSeed + n
+const int GamesPerPass = 8;    // whole games played per timing pass
+const char Directions[] = { 'w', 'a', 's', 'd' };
+
+
+struct Measurement
+{
+    string benchmark;
+    string variant;
+    int squaresPerSide;
+    double opsPerSecond;
+};
+
+
+// Fill the corpus with random boards: about a third empty squares, the rest 2 up to 64
+void makeCorpus( int corpus[], int squaresPerSide, unsigned seed)
+{
+    GameRng rng( seed);
+    int cells = squaresPerSide * squaresPerSide;
+    for( int i=0; i<CorpusSize * cells; i++) {
+        int e = (int)rng.below( 9) - 2;
+        corpus[ i] = (e <= 0) ? 0 : (1 << e);
+    }
+}
+
+
+// Reference move, as selected in main()
+void genericMove( int play[], int squaresPerSide, char direction, int &score)
+{
+    switch( direction) {
+        case 'w': Up1( play, squaresPerSide, score);        break;
+        case 'a': Left1( play, squaresPerSide, score);      break;
+        case 's': Down1( play, squaresPerSide, score);      break;
+        case 'd': slideRight( play, squaresPerSide, score); break;
+    }
+}
+
+
+double secondsSince( chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double>( chrono::steady_clock::now() - start).count();
+}
+
+
+// Repeat pass() until the time budget is used.  Each pass does opsPerPass operations;
+// returns operations per second.
+template <class Pass>
+double timePasses( double budget, long opsPerPass, Pass pass)
+{
+    long ops = 0;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    do {
+        pass();
+        ops += opsPerPass;
+    } while( secondsSince( start) < budget);
+    return ops / secondsSince( start);
+}
+
+
+// Returns true if moving every tile of before as the motions say gives after: each tile
+// moves once, onto an empty square or onto the one tile it merges with
+bool motionsMatch( const int before[], const MoveMotions &motions, int after[], int squaresPerSide)
+{
+    int cells = squaresPerSide * squaresPerSide;
+    int rebuilt[ MaxBoardSize * MaxBoardSize] = { 0 };
+    int tiles = 0;
+    for( int i=0; i<cells; i++) {
+        tiles += (before[ i] != 0);
+    }
+    for( int m=0; m<motions.count; m++) {
+        const TileMotion &motion = motions.motions[ m];
+        int value = before[ motion.source];
+        int &square = rebuilt[ motion.destination];
+        if( motion.merged ? square != value : square != 0) {
+            return false;
+        }
+        square += value;
+    }
+    return motions.count == tiles && !Board1( rebuilt, after, squaresPerSide);
+}
+
+
+// Returns false if a specialized kernel disagrees with the generic loops, a board
+// summary kept up to date from its move results disagrees with counting again,
+// a move's changed flag or the legal move set disagrees with comparing the boards,
+// or the traced move's motions do not account for the tiles
+bool kernelsMatch( const BoardKernels &kernels, int corpus[], int squaresPerSide)
+{
+    int cells = squaresPerSide * squaresPerSide;
+    for( int p=0; p<CorpusSize; p++) {
+        for( int d=0; d<4; d++) {
+            int expected[ MaxBoardSize * MaxBoardSize];
+            int actual[ MaxBoardSize * MaxBoardSize];
+            int expectedScore = 0;
+            int actualScore = 0;
+            memcpy( expected, corpus + p*cells, cells * sizeof( int));
+            memcpy( actual, corpus + p*cells, cells * sizeof( int));
+            genericMove( expected, squaresPerSide, Directions[ d], expectedScore);
+            MoveResult result = applyMove( kernels, actual, Directions[ d], actualScore);
+            if( Board1( expected, actual, squaresPerSide) || expectedScore != actualScore) {
+                return false;
+            }
+            BoardSummary tracked = kernels.summarize( corpus + p*cells);
+            summarizeMove( tracked, result);
+            BoardSummary counted = kernels.summarize( actual);
+            if( tracked.empty != counted.empty || tracked.maxTile != counted.maxTile) {
+                return false;
+            }
+            bool changed = Board1( corpus + p*cells, actual, squaresPerSide);
+            bool legal = (kernels.legalMoves( corpus + p*cells) & directionBit( Directions[ d])) != 0;
+            if( result.changed != changed || legal != changed) {
+                return false;
+            }
+            int traced[ MaxBoardSize * MaxBoardSize];
+            int tracedScore = 0;
+            MoveMotions motions;
+            memcpy( traced, corpus + p*cells, cells * sizeof( int));
+            MoveResult tracedResult = applyMove( kernels, traced, Directions[ d], tracedScore, &motions);
+            if( Board1( expected, traced, squaresPerSide) || tracedScore != expectedScore
+                || tracedResult.changed != changed || !motionsMatch( corpus + p*cells, motions, traced, squaresPerSide)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+
+// Returns false if batchMove disagrees with the generic loops on any board of the
+// corpus, in its new squares, its score or whether it changed
+bool batchMatches( const BoardBatch &batch, int corpus[], int squaresPerSide, char direction, SimdLevel level)
+{
+    int cells = squaresPerSide * squaresPerSide;
+    BoardBatch moved;
+    batchMove( batch, direction, moved, NULL, level);
+    for( int p=0; p<CorpusSize; p++) {
+        int expected[ MaxBoardSize * MaxBoardSize];
+        int actual[ MaxBoardSize * MaxBoardSize];
+        int expectedScore = 0;
+        memcpy( expected, corpus + p*cells, cells * sizeof( int));
+        genericMove( expected, squaresPerSide, direction, expectedScore);
+        batchGetBoard( moved, p, actual);
+        bool changed = Board1( corpus + p*cells, expected, squaresPerSide);
+        if( Board1( expected, actual, squaresPerSide) || expectedScore != moved.scores[ p]
+            || changed != (moved.changed[ p] != 0)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+//--------------------------------------------------------------------
+// Time every primitive on one board size, adding the measurements to results.  Values
+// computed go into checksum so that nothing is optimized away.
+void benchmarkSize( int squaresPerSide, double budget, vector<Measurement> &results,
+                    long &checksum, bool &allMatch)
+{
+    static int corpus[ CorpusSize * MaxBoardSize * MaxBoardSize];
+    static BitBoard bitCorpus[ CorpusSize];
+    static BoardKey keyCorpus[ CorpusSize];
+    int cells = squaresPerSide * squaresPerSide;
+    int work[ MaxBoardSize * MaxBoardSize];
+    makeCorpus( corpus, squaresPerSide, CorpusSeed + squaresPerSide);
+    BoardBatch batch, batchMoved;
+    batchResize( batch, squaresPerSide, CorpusSize);
+    for( int p=0; p<CorpusSize; p++) {
+        bitboardFromArray( bitCorpus[ p], corpus + p*cells, squaresPerSide);
+        boardKeyFromArray( keyCorpus[ p], corpus + p*cells, squaresPerSide);
+        batchSetBoard( batch, p, corpus + p*cells);
+    }
+    Measurement m;
+    m.squaresPerSide = squaresPerSide;
+
+    // Each move on its own, copying every position before moving it so that all
+    // engines do the same work
+    const char *moveNames[ 4] = { "Up1", "Left1", "Down1", "slideRight" };
+    for( int d=0; d<4; d++) {
+        char direction = Directions[ d];
+        m.benchmark = moveNames[ d];
+        m.variant = "generic";
+        m.opsPerSecond = timePasses( budget, CorpusSize, [&]() {
+            for( int p=0; p<CorpusSize; p++) {
+                int score = 0;
+                memcpy( work, corpus + p*cells, cells * sizeof( int));
+                genericMove( work, squaresPerSide, direction, score);
+                checksum += score + work[ p % cells];
+            }
+        });
+        results.push_back( m);
+
+        // Scalar specialized kernels, then each vector level this CPU supports
+        const int Variants = 3;
+        const char *variantNames[ Variants] = { "template", "sse4.1", "avx2" };
+        SimdLevel variantLevels[ Variants] = { SimdNone, SimdSse41, SimdAvx2 };
+        for( int v=0; v<Variants; v++) {
+            BoardKernels kernels = scalarBoardKernels( squaresPerSide);
+            if( variantLevels[ v] != SimdNone && !useSimdRows( kernels, variantLevels[ v])) {
+                continue;   // not supported here, or not used on this board size
+            }
+            if( d == 0 && !kernelsMatch( kernels, corpus, squaresPerSide)) {
+                cerr << variantNames[ v] << " kernels do not match the generic moves on "
+                     << squaresPerSide << "x" << squaresPerSide << " boards" << endl;
+                allMatch = false;
+            }
+            m.variant = variantNames[ v];
+            m.opsPerSecond = timePasses( budget, CorpusSize, [&]() {
+                for( int p=0; p<CorpusSize; p++) {
+                    int score = 0;
+                    memcpy( work, corpus + p*cells, cells * sizeof( int));
+                    applyMove( kernels, work, direction, score);
+                    checksum += score + work[ p % cells];
+                }
+            });
+            results.push_back( m);
+        }
+
+        m.variant = "bitboard";
+        m.opsPerSecond = timePasses( budget, CorpusSize, [&]() {
+            for( int p=0; p<CorpusSize; p++) {
+                int score = 0;
+                BitBoard moved = bitCorpus[ p];
+                bitboardMove( moved, direction, score);
+                checksum += score + (long)(moved.words[ 0] & 0xFF);
+            }
+        });
+        results.push_back( m);
+
+        // The whole corpus in one call, eight boards at a time
+        for( int v=0; v<2; v++) {
+            SimdLevel level = (v == 0) ? SimdNone : SimdAvx2;
+            if( level > simdSupported()) {
+                continue;
+            }
+            if( !batchMatches( batch, corpus, squaresPerSide, direction, level)) {
+                cerr << "batchMove " << (v == 0 ? "lanes" : "avx2") << " does not match the generic moves on "
+                     << squaresPerSide << "x" << squaresPerSide << " boards" << endl;
+                allMatch = false;
+            }
+            m.variant = (v == 0) ? "batch" : "batch avx2";
+            m.opsPerSecond = timePasses( budget, CorpusSize, [&]() {
+                batchMove( batch, direction, batchMoved, NULL, level);
+                checksum += batchMoved.scores[ 0];
+            });
+            results.push_back( m);
+        }
+    }
+
+    const BoardKernels &kernels = boardKernels( squaresPerSide);
+    int Tile = winningTile( squaresPerSide);
+    GameRng rng( CorpusSeed);
+
+    // A new piece on a copy of each position
+    m.benchmark = "Random1";
+    m.variant = "generic";
+    m.opsPerSecond = timePasses( budget, CorpusSize, [&]() {
+        for( int p=0; p<CorpusSize; p++) {
+            memcpy( work, corpus + p*cells, cells * sizeof( int));
+            checksum += Random1( work, squaresPerSide, rng);
+        }
+    });
+    results.push_back( m);
+
+    // End of game checks, with gameEnds' messages sent nowhere
+    m.benchmark = "gameEnds";
+    m.opsPerSecond = timePasses( budget, CorpusSize, [&]() {
+        ostringstream discard;
+        streambuf *pConsole = cout.rdbuf( discard.rdbuf());
+        for( int p=0; p<CorpusSize; p++) {
+            checksum += gameEnds( corpus + p*cells, squaresPerSide, Tile);
+        }
+        cout.rdbuf( pConsole);
+    });
+    results.push_back( m);
+
+    m.benchmark = "gameStatus";
+    m.variant = "template";
+    m.opsPerSecond = timePasses( budget, CorpusSize, [&]() {
+        for( int p=0; p<CorpusSize; p++) {
+            checksum += kernels.gameStatus( corpus + p*cells, Tile);
+        }
+    });
+    results.push_back( m);
+
+    m.benchmark = "legalMoves";
+    m.opsPerSecond = timePasses( budget, CorpusSize, [&]() {
+        for( int p=0; p<CorpusSize; p++) {
+            checksum += kernels.legalMoves( corpus + p*cells);
+        }
+    });
+    results.push_back( m);
+
+    // Copy a position, then compare it with the next one
+    m.benchmark = "duplicate+Board1";
+    m.variant = "generic";
+    m.opsPerSecond = timePasses( budget, CorpusSize, [&]() {
+        for( int p=0; p<CorpusSize; p++) {
+            duplicate( work, corpus + p*cells, squaresPerSide);
+            checksum += Board1( work, corpus + ((p+1) % CorpusSize) * cells, squaresPerSide);
+        }
+    });
+    results.push_back( m);
+
+    m.variant = "template";
+    m.opsPerSecond = timePasses( budget, CorpusSize, [&]() {
+        for( int p=0; p<CorpusSize; p++) {
+            kernels.duplicate( work, corpus + p*cells);
+            checksum += kernels.Board1( work, corpus + ((p+1) % CorpusSize) * cells);
+        }
+    });
+    results.push_back( m);
+
+    // Pack each position into a key, compare keys as Board1 compares boards, and find
+    // the canonical form and hash of each key
+    BoardKey key;
+    m.benchmark = "board key";
+    m.variant = "pack";
+    m.opsPerSecond = timePasses( budget, CorpusSize, [&]() {
+        for( int p=0; p<CorpusSize; p++) {
+            boardKeyFromArray( key, corpus + p*cells, squaresPerSide);
+            checksum += key.words[ 0] & 0xFF;
+        }
+    });
+    results.push_back( m);
+
+    m.variant = "compare";
+    m.opsPerSecond = timePasses( budget, CorpusSize, [&]() {
+        for( int p=0; p<CorpusSize; p++) {
+            checksum += boardKeyEqual( keyCorpus[ p], keyCorpus[ (p+1) % CorpusSize]);
+        }
+    });
+    results.push_back( m);
+
+    m.variant = "canonical";
+    m.opsPerSecond = timePasses( budget, CorpusSize, [&]() {
+        for( int p=0; p<CorpusSize; p++) {
+            checksum += canonicalBoardKey( keyCorpus[ p], key);
+        }
+    });
+    results.push_back( m);
+
+    m.variant = "hash";
+    m.opsPerSecond = timePasses( budget, CorpusSize, [&]() {
+        for( int p=0; p<CorpusSize; p++) {
+            checksum += boardKeyHash( keyCorpus[ p]) & 0xFF;
+        }
+    });
+    results.push_back( m);
+
+    // Save every position of the corpus in the undo history, then undo back to the first.
+    // This is what appendNode and erase did before the history kept only differences.
+    UndoHistory history( 0);
+    m.benchmark = "history push+pop";
+    m.variant = "delta";
+    m.opsPerSecond = timePasses( budget, CorpusSize, [&]() {
+        history.reset( squaresPerSide);
+        for( int p=0; p<CorpusSize; p++) {
+            history.push( corpus + p*cells, p, p);
+        }
+        int score, step;
+        while( history.pop( work, score, step)) {
+            checksum += score;
+        }
+    });
+    results.push_back( m);
+
+    // Hints for one position after another, each start() cancelling the deeper search
+    // still running on the one before: the time until the new position's first hint
+    HintService hints;
+    m.benchmark = "hint restart";
+    m.variant = "cancel+depth 1";
+    int hinted = 0;
+    m.opsPerSecond = timePasses( budget, 1, [&]() {
+        const int *pBoard;
+        do {
+            pBoard = corpus + (hinted++ % CorpusSize) * cells;
+        } while( kernels.legalMoves( pBoard) == 0);
+        hints.start( pBoard, squaresPerSide);
+        Hint hint;
+        while( !hints.poll( hint)) {
+            this_thread::sleep_for( chrono::microseconds( 20));   // leaves the core to the search on one-core machines
+        }
+        checksum += hint.depth;
+    });
+    results.push_back( m);
+
+    // Whole games; the moves made in them are reported as a second measurement
+    MovePolicy *pPolicy = createPolicy( "random");
+    long movesPlayed = 0;
+    long gamesPlayed = 0;
+    m.benchmark = "playGame";
+    m.variant = "random";
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    m.opsPerSecond = timePasses( budget, GamesPerPass, [&]() {
+        for( int g=0; g<GamesPerPass; g++) {
+            GameRng gameRng( CorpusSeed, gamesPlayed++);
+            GameResult game = playGame( squaresPerSide, *pPolicy, gameRng);
+            movesPlayed += game.moves;
+            checksum += game.score;
+        }
+    });
+    double gameSeconds = secondsSince( start);
+    results.push_back( m);
+    m.benchmark = "playGame moves";
+    m.opsPerSecond = movesPlayed / gameSeconds;
+    results.push_back( m);
+    delete pPolicy;
+}
+
+
+//--------------------------------------------------------------------
+const char *simdName( SimdLevel level)
+{
+    switch( level) {
+        case SimdAvx2:  return "avx2";
+        case SimdSse41: return "sse4.1";
+        case SimdNone:  break;
+    }
+    return "none";
+}
+
+
+void printTable( const vector<Measurement> &results)
+{
+    cout << "Operations per second, " << CorpusSize << " positions per size\n\n";
+    cout << setw( 6) << "size" << "  " << left << setw( 18) << "benchmark" << setw( 12) << "variant"
+         << right << setw( 12) << "Mops/sec" << setw( 12) << "ns/op" << "\n";
+    for( size_t i=0; i<results.size(); i++) {
+        const Measurement &m = results[ i];
+        char label[ 16];
+        sprintf( label, "%dx%d", m.squaresPerSide, m.squaresPerSide);
+        cout << fixed << setprecision( 3) << setw( 6) << label << "  " << left << setw( 18) << m.benchmark
+             << setw( 12) << m.variant << right << setw( 12) << m.opsPerSecond / 1e6
+             << setprecision( 1) << setw( 12) << 1e9 / m.opsPerSecond << "\n";
+    }
+}
+
+
+void printCsv( const vector<Measurement> &results)
+{
+    cout << "benchmark,variant,size,ops_per_sec,ns_per_op\n";
+    for( size_t i=0; i<results.size(); i++) {
+        const Measurement &m = results[ i];
+        cout << m.benchmark << "," << m.variant << "," << m.squaresPerSide << "," << fixed
+             << setprecision( 1) << m.opsPerSecond << "," << setprecision( 3) << 1e9 / m.opsPerSecond << "\n";
+    }
+}
+
+
+void printJson( const vector<Measurement> &results, double budget, bool allMatch)
+{
+    cout << "{\n  \"corpusSize\": " << CorpusSize << ",\n  \"corpusSeed\": " << CorpusSeed
+         << ",\n  \"secondsPerMeasurement\": " << budget
+         << ",\n  \"simd\": \"" << simdName( simdSupported()) << "\""
+         << ",\n  \"kernelsMatch\": " << (allMatch ? "true" : "false")
+         << ",\n  \"results\": [\n" << fixed;
+    for( size_t i=0; i<results.size(); i++) {
+        const Measurement &m = results[ i];
+        cout << "    { \"benchmark\": \"" << m.benchmark << "\", \"variant\": \"" << m.variant
+             << "\", \"size\": " << m.squaresPerSide
+             << ", \"opsPerSec\": " << setprecision( 1) << m.opsPerSecond
+             << ", \"nsPerOp\": " << setprecision( 3) << 1e9 / m.opsPerSecond << " }"
+             << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    cout << "  ]\n}\n";
+}
+
+
+void displayUsage()
+{
+    cout << "Usage: bench [options]\n"
+         << "  --seconds S               time spent on each measurement (default 0.25)\n"
+         << "  --format table|csv|json   how to print the results (default table)\n"
+         << "  --sizes A-B               board sizes to run, within 4-" << MaxBoardSize << " (default all)\n";
+}
+
+
+int main( int argc, char *argv[])
+{
+    double budget = 0.25;   // seconds per measurement
+    string format = "table";
+    int smallest = 4;
+    int largest = MaxBoardSize;
+    for( int i=1; i<argc; i+=2) {
+        if( i + 1 >= argc) {
+            displayUsage();
+            return 1;
+        }
+        if( strcmp( argv[ i], "--seconds") == 0) {
+            budget = atof( argv[ i+1]);
+        }
+        else if( strcmp( argv[ i], "--format") == 0) {
+            format = argv[ i+1];
+        }
+        else if( strcmp( argv[ i], "--sizes") == 0) {
+            if( sscanf( argv[ i+1], "%d-%d", &smallest, &largest) == 1) {
+                largest = smallest;
+            }
+        }
+        else {
+            displayUsage();
+            return 1;
+        }
+    }
+    if( smallest < 4 || largest > MaxBoardSize || smallest > largest
+        || (format != "table" && format != "csv" && format != "json")) {
+        displayUsage();
+        return 1;
+    }
+
+    vector<Measurement> results;
+    long checksum = 0;
+    bool allMatch = true;
+    streambuf *pOut = cout.rdbuf( cerr.rdbuf());   // mismatches go to cerr, as with the kernels
+    allMatch = bitboardMatchesReference( 2000, CorpusSeed) && boardKeysMatchReference( 200, CorpusSeed)
+               && historyMatchesReference( 2000, CorpusSeed);
+    cout.rdbuf( pOut);
+    for( int squaresPerSide=smallest; squaresPerSide<=largest; squaresPerSide++) {
+        benchmarkSize( squaresPerSide, budget, results, checksum, allMatch);
+    }
+
+    if( format == "csv") {
+        printCsv( results);
+    }
+    else if( format == "json") {
+        printJson( results, budget, allMatch);
+    }
+    else {
+        printTable( results);
+        cout << "\n(checksum " << checksum << ")" << endl;
+    }
+    return allMatch ? 0 : 1;
+}
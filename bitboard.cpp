@@ -0,0 +1,447 @@
+//
+// Bitboard version of the 1024 move engine.  See bitboard.h for the board layout.
+//
+#include "bitboard.h"
+#include <cassert>           // For assert()
+#include <iostream>          // For cout, endl
+
+
+const int WideBits = 5;                           // bits per square on boards larger than 4x4
+const uint64_t WideMask = (1 << WideBits) - 1;    // mask for one square on a wide row
+
+
+//--------------------------------------------------------------------
+// Row lookup tables for the 4x4 board.  Each 16-bit row of four exponents indexes
+// the resulting row after sliding left or right, and the score gained by that slide.
+struct RowTables
+{
+    uint16_t left[ 65536];
+    uint16_t right[ 65536];
+    int leftScore[ 65536];
+    int rightScore[ 65536];
+};
+
+
+// Slide the exponents in row[] toward index 0, combining each pair of equal
+// neighbours at most once, so  1 1 2 2  becomes  2 3 0 0  just as Left1 turns
+// 2 2 4 4 into 4 8 0 0.  The combined tile values are added to score.
+// Exponents equal to maxExponent are never combined, since the result would not fit.
+static void slideExponents( int row[], int n, int maxExponent, int &score)
+{
+    int next = 0;       // index where the next tile will be placed
+    int pending = 0;    // exponent of the last placed tile if it can still combine, else 0
+    for( int i=0; i<n; i++) {
+        int e = row[ i];
+        if( e == 0) {
+            continue;
+        }
+        if( e == pending && e < maxExponent) {
+            row[ next-1] = e + 1;
+            score += 1 << (e + 1);
+            pending = 0;       // the combined tile cannot combine again on this move
+        }
+        else {
+            row[ next++] = e;
+            pending = e;
+        }
+    }
+    while( next < n) {
+        row[ next++] = 0;
+    }
+}
+
+
+static RowTables *buildRowTables()
+{
+    RowTables *pTables = new RowTables;
+    for( int r=0; r<65536; r++) {
+        int row[ 4];
+        int reversed[ 4];
+        for( int c=0; c<4; c++) {
+            row[ c] = (r >> (4*c)) & 0xF;
+            reversed[ 3-c] = row[ c];
+        }
+
+        int score = 0;
+        slideExponents( row, 4, 15, score);
+        pTables->left[ r] = row[ 0] | (row[ 1] << 4) | (row[ 2] << 8) | (row[ 3] << 12);
+        pTables->leftScore[ r] = score;
+
+        score = 0;
+        slideExponents( reversed, 4, 15, score);
+        pTables->right[ r] = reversed[ 3] | (reversed[ 2] << 4) | (reversed[ 1] << 8) | (reversed[ 0] << 12);
+        pTables->rightScore[ r] = score;
+    }
+    return pTables;
+}
+
+
+// The tables are built once, on first use, and shared by all threads
+static const RowTables &rowTables()
+{
+    static const RowTables *pTables = buildRowTables();
+    return *pTables;
+}
+
+
+//--------------------------------------------------------------------
+// Transpose a 4x4 board of nibbles, turning columns into rows
+static uint64_t transpose4( uint64_t x)
+{
+    uint64_t a1 = x & 0xF0F00F0FF0F00F0FULL;
+    uint64_t a2 = x & 0x0000F0F00000F0F0ULL;
+    uint64_t a3 = x & 0x0F0F00000F0F0000ULL;
+    uint64_t a = a1 | (a2 << 12) | (a3 >> 12);
+    uint64_t b1 = a & 0xFF00FF0000FF00FFULL;
+    uint64_t b2 = a & 0x00FF00FF00000000ULL;
+    uint64_t b3 = a & 0x00000000FF00FF00ULL;
+    return b1 | (b2 >> 24) | (b3 << 24);
+}
+
+
+uint64_t bitboardTranspose4( uint64_t board)
+{
+    return transpose4( board);
+}
+
+
+// Apply a row table to each of the four rows
+static uint64_t moveRows4( uint64_t board, const uint16_t table[], const int scores[], int &score)
+{
+    uint64_t result = 0;
+    for( int r=0; r<4; r++) {
+        int row = (board >> (16*r)) & 0xFFFF;
+        result |= (uint64_t)table[ row] << (16*r);
+        score += scores[ row];
+    }
+    return result;
+}
+
+
+uint64_t bitboardMove4( uint64_t board, char direction, int &score)
+{
+    const RowTables &tables = rowTables();
+    switch( direction) {
+        case 'a':
+            return moveRows4( board, tables.left, tables.leftScore, score);
+        case 'd':
+            return moveRows4( board, tables.right, tables.rightScore, score);
+        case 'w':
+            // Columns become rows, so sliding up is sliding the transposed rows left
+            return transpose4( moveRows4( transpose4( board), tables.left, tables.leftScore, score));
+        case 's':
+            return transpose4( moveRows4( transpose4( board), tables.right, tables.rightScore, score));
+    }
+    return board;
+}
+
+
+//--------------------------------------------------------------------
+// Slide one row of a larger board toward square 0, using the same merge-once rule
+// as slideExponents but working directly on the packed 5-bit squares.
+static uint64_t slideWideRow( uint64_t row, int n, int &score)
+{
+    uint64_t result = 0;
+    int shift = 0;       // bit position of the next placed tile
+    int pending = 0;     // exponent of the last tile read if it can still combine, else 0
+    for( int c=0; c<n; c++) {
+        int e = (row >> (WideBits*c)) & WideMask;
+        if( e == 0) {
+            continue;
+        }
+        if( e == pending) {
+            result |= (uint64_t)(e + 1) << shift;
+            shift += WideBits;
+            score += 1 << (e + 1);
+            pending = 0;
+        }
+        else {
+            if( pending != 0) {
+                result |= (uint64_t)pending << shift;
+                shift += WideBits;
+            }
+            pending = e;
+        }
+    }
+    if( pending != 0) {
+        result |= (uint64_t)pending << shift;
+    }
+    return result;
+}
+
+
+// Reverse the order of the squares in a row, so a slide right becomes a slide left
+static uint64_t reverseWideRow( uint64_t row, int n)
+{
+    uint64_t result = 0;
+    for( int c=0; c<n; c++) {
+        result |= ((row >> (WideBits*c)) & WideMask) << (WideBits*(n-1-c));
+    }
+    return result;
+}
+
+
+// Transpose a board stored as one word per row
+static void transposeWide( uint64_t words[], int n)
+{
+    uint64_t result[ MaxBoardSize];
+    for( int c=0; c<n; c++) {
+        result[ c] = 0;
+    }
+    for( int r=0; r<n; r++) {
+        for( int c=0; c<n; c++) {
+            result[ c] |= ((words[ r] >> (WideBits*c)) & WideMask) << (WideBits*r);
+        }
+    }
+    for( int c=0; c<n; c++) {
+        words[ c] = result[ c];
+    }
+}
+
+
+static void moveWideRows( uint64_t words[], int n, bool towardEnd, int &score)
+{
+    for( int r=0; r<n; r++) {
+        if( towardEnd) {
+            words[ r] = reverseWideRow( slideWideRow( reverseWideRow( words[ r], n), n, score), n);
+        }
+        else {
+            words[ r] = slideWideRow( words[ r], n, score);
+        }
+    }
+}
+
+
+void bitboardMove( BitBoard &bits, char direction, int &score)
+{
+    if( bits.size == 4) {
+        bits.words[ 0] = bitboardMove4( bits.words[ 0], direction, score);
+        return;
+    }
+
+    switch( direction) {
+        case 'a':
+            moveWideRows( bits.words, bits.size, false, score);
+            break;
+        case 'd':
+            moveWideRows( bits.words, bits.size, true, score);
+            break;
+        case 'w':
+            transposeWide( bits.words, bits.size);
+            moveWideRows( bits.words, bits.size, false, score);
+            transposeWide( bits.words, bits.size);
+            break;
+        case 's':
+            transposeWide( bits.words, bits.size);
+            moveWideRows( bits.words, bits.size, true, score);
+            transposeWide( bits.words, bits.size);
+            break;
+    }
+}
+
+
+//--------------------------------------------------------------------
+// Single squares
+
+// Bit position of a square within its word
+static int squareShift( int size, int index)
+{
+    if( size == 4) {
+        return 4 * index;   // row r starts at bit 16r, so square r*4+c is at 4(r*4+c)
+    }
+    return WideBits * (index % size);
+}
+
+
+int bitboardGet( const BitBoard &bits, int index)
+{
+    if( bits.size == 4) {
+        return (bits.words[ 0] >> squareShift( 4, index)) & 0xF;
+    }
+    return (bits.words[ index / bits.size] >> squareShift( bits.size, index)) & WideMask;
+}
+
+
+void bitboardSet( BitBoard &bits, int index, int exponent)
+{
+    uint64_t &word = bits.words[ bits.size == 4 ? 0 : index / bits.size];
+    uint64_t mask = (bits.size == 4) ? 0xF : WideMask;
+    int shift = squareShift( bits.size, index);
+    word = (word & ~(mask << shift)) | ((uint64_t)exponent << shift);
+}
+
+
+bool bitboardEqual( const BitBoard &a, const BitBoard &b)
+{
+    int words = (a.size == 4) ? 1 : a.size;
+    for( int w=0; w<words; w++) {
+        if( a.words[ w] != b.words[ w]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+//--------------------------------------------------------------------
+// Conversion to and from the int[] board
+// A 4x4 board keeps each exponent in a 4-bit nibble, so its tiles must stay below
+// 32768 (2^15); the 5-bit squares of larger boards hold any int tile
+static int exponentOf( int value)
+{
+    int exponent = 0;
+    while( value > 1) {
+        value = value / 2;
+        exponent++;
+    }
+    return exponent;
+}
+
+
+bool bitboardFits( const int play[], int squaresPerSide)
+{
+    if( squaresPerSide != 4) {
+        return true;
+    }
+    for( int i=0; i<16; i++) {
+        if( play[ i] >= (1 << 15)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+void bitboardFromArray( BitBoard &bits, const int play[], int squaresPerSide)
+{
+    bits.size = squaresPerSide;
+    for( int r=0; r<MaxBoardSize; r++) {
+        bits.words[ r] = 0;
+    }
+    for( int r=0; r<squaresPerSide; r++) {
+        for( int c=0; c<squaresPerSide; c++) {
+            uint64_t e = exponentOf( play[ r*squaresPerSide + c]);
+            assert( e < (squaresPerSide == 4 ? 16u : 1u << WideBits));
+            if( squaresPerSide == 4) {
+                bits.words[ 0] |= e << (16*r + 4*c);
+            }
+            else {
+                bits.words[ r] |= e << (WideBits*c);
+            }
+        }
+    }
+}
+
+
+void bitboardToArray( const BitBoard &bits, int play[])
+{
+    int n = bits.size;
+    for( int r=0; r<n; r++) {
+        for( int c=0; c<n; c++) {
+            int e;
+            if( n == 4) {
+                e = (bits.words[ 0] >> (16*r + 4*c)) & 0xF;
+            }
+            else {
+                e = (bits.words[ r] >> (WideBits*c)) & WideMask;
+            }
+            play[ r*n + c] = (e == 0) ? 0 : (1 << e);
+        }
+    }
+}
+
+
+//--------------------------------------------------------------------
+// Differential check against the reference moves
+
+// Apply one of the reference int[] moves, as selected in main()
+static void referenceMove( int play[], int squaresPerSide, char direction, int &score)
+{
+    switch( direction) {
+        case 'w': Up1( play, squaresPerSide, score);        break;
+        case 'a': Left1( play, squaresPerSide, score);      break;
+        case 's': Down1( play, squaresPerSide, score);      break;
+        case 'd': slideRight( play, squaresPerSide, score); break;
+    }
+}
+
+
+// Compare one move on both engines, printing the position if they disagree
+static bool checkMove( int play[], int squaresPerSide, char direction)
+{
+    BitBoard bits;
+    bitboardFromArray( bits, play, squaresPerSide);
+
+    int referenceScore = 0;
+    int bitboardScore = 0;
+    int before[ MaxBoardSize * MaxBoardSize];
+    int result[ MaxBoardSize * MaxBoardSize];
+    duplicate( before, play, squaresPerSide);
+    referenceMove( play, squaresPerSide, direction, referenceScore);
+    bitboardMove( bits, direction, bitboardScore);
+    bitboardToArray( bits, result);
+
+    if( !Board1( result, play, squaresPerSide) && referenceScore == bitboardScore) {
+        return true;
+    }
+    std::cout << "Bitboard mismatch on " << squaresPerSide << "x" << squaresPerSide
+              << " board, move '" << direction << "'" << std::endl;
+    std::cout << "Before:";
+    BoardVisual( before, squaresPerSide, 0);
+    std::cout << "Reference:";
+    BoardVisual( play, squaresPerSide, referenceScore);
+    std::cout << "Bitboard:";
+    BoardVisual( result, squaresPerSide, bitboardScore);
+    return false;
+}
+
+
+bool bitboardMatchesReference( int positions, unsigned seed)
+{
+    const char directions[] = { 'w', 'a', 's', 'd' };
+    GameRng rng( seed);
+
+    for( int squaresPerSide=4; squaresPerSide<=MaxBoardSize; squaresPerSide++) {
+        int play[ MaxBoardSize * MaxBoardSize];
+        int cells = squaresPerSide * squaresPerSide;
+
+        // Random positions with small tiles, so that many squares combine
+        for( int p=0; p<positions; p++) {
+            int direction = p % 4;
+            for( int i=0; i<cells; i++) {
+                int e = rng.below( 5);
+                play[ i] = (e == 0) ? 0 : (1 << e);
+            }
+            if( !checkMove( play, squaresPerSide, directions[ direction])) {
+                return false;
+            }
+        }
+
+        // Random games, placing a piece after every move that changes the board
+        for( int g=0; g<positions/100 + 1; g++) {
+            for( int i=0; i<cells; i++) {
+                play[ i] = 0;
+            }
+            Random1( play, squaresPerSide, rng);
+            Random1( play, squaresPerSide, rng);
+            // Stop once a run of random moves has left the board unchanged, or after
+            // enough moves to have filled the board several times over
+            int unchanged = 0;
+            for( int m=0; m<cells*10 && unchanged<16; m++) {
+                int before[ MaxBoardSize * MaxBoardSize];
+                duplicate( before, play, squaresPerSide);
+                if( !checkMove( play, squaresPerSide, directions[ rng.below( 4)])) {
+                    return false;
+                }
+                if( Board1( before, play, squaresPerSide)) {
+                    Random1( play, squaresPerSide, rng);
+                    unchanged = 0;
+                }
+                else {
+                    unchanged++;
+                }
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,57 @@
+//
+// Bitboard version of the 1024 move engine.
+//
+// Each square holds the log2 exponent of its tile instead of the tile value itself
+// (0 for an empty square, 1 for a 2, 2 for a 4, and so on).  A 4x4 board packs all
+// sixteen squares as 4-bit exponents into a single 64-bit word, with row r in bits
+// 16r..16r+15, so a move is four lookups in precomputed row tables plus a transpose
+// for the vertical moves.  Larger boards store one row per 64-bit word using 5-bit
+// exponents (12 squares x 5 bits = 60 bits), which is enough for the 2^18 winning tile
+// on a 12x12 board.
+//
+// The int[] functions in game.h remain the reference implementation; the bitboard
+// moves give exactly the same board and the same score as slideRight, Left1, Up1 and Down1.
+//
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#include <cstdint>
+#include "game.h"
+
+struct BitBoard
+{
+    uint64_t words[ MaxBoardSize];   // words[0] for a 4x4 board, otherwise one word per row
+    int size;                        // squares per side
+};
+
+// Convert between the int[] board and the packed exponent board.  Tile values must be
+// powers of two; on a 4x4 board they must also be below 32768 to fit in four bits.
+void bitboardFromArray( BitBoard &bits, const int play[], int squaresPerSide);
+void bitboardToArray( const BitBoard &bits, int play[]);
+
+// True if every tile on the board fits its square of a bitboard.  Only a 4x4 board
+// with a tile of 32768 or more does not; merges can make one even when it cannot be
+// placed, so callers check before converting.
+bool bitboardFits( const int play[], int squaresPerSide);
+
+// Slide all tiles in the given direction ('w', 'a', 's' or 'd', as in main()),
+// combining matching values and adding the combined values to score.
+void bitboardMove( BitBoard &bits, char direction, int &score);
+
+// Same as bitboardMove, for a 4x4 board held in a single word
+uint64_t bitboardMove4( uint64_t board, char direction, int &score);
+
+// Swap rows and columns of a 4x4 board held in a single word
+uint64_t bitboardTranspose4( uint64_t board);
+
+// Read and write the exponent of one square, indexed as in the int[] board
+int bitboardGet( const BitBoard &bits, int index);
+void bitboardSet( BitBoard &bits, int index, int exponent);
+
+bool bitboardEqual( const BitBoard &a, const BitBoard &b);
+
+// Differential check against the reference int[] moves on every board size, using
+// random positions and random games.  Prints any mismatch and returns false if one is found.
+bool bitboardMatchesReference( int positions, unsigned seed);
+
+#endif
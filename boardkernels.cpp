@@ -0,0 +1,71 @@
+//
+// Dispatch table for the board-size specialized kernels in boardkernels.h.
+//
+#include "boardkernels.h"
+#include "simdrows.h"
+#include <cassert>           // For assert()
+#include <iostream>          // For cout, endl
+
+
+#define KERNELS( N) { N, slideRightN<N>, Left1N<N>, Up1N<N>, Down1N<N>, \
+                      duplicateN<N>, Board1N<N>, gameStatusN<N>, hasPairsN<N>, summarizeN<N>, \
+                      legalMovesN<N>, traceMoveN<N> }
+
+static const BoardKernels kernelTable[] = {
+    KERNELS( 4), KERNELS( 5), KERNELS( 6), KERNELS( 7), KERNELS( 8),
+    KERNELS( 9), KERNELS( 10), KERNELS( 11), KERNELS( 12)
+};
+
+#undef KERNELS
+
+
+// Position of a board size in the kernel tables.  Callers check sizes where they are
+// entered, since kernels for another size would quietly play the wrong game.
+static int kernelIndex( int squaresPerSide)
+{
+    assert( squaresPerSide >= 4 && squaresPerSide <= MaxBoardSize);
+    return squaresPerSide - 4;
+}
+
+
+// The scalar kernels, with the vector row kernels swapped in where this CPU supports them
+static const BoardKernels *buildBestKernels()
+{
+    BoardKernels *pBest = new BoardKernels[ MaxBoardSize - 3];
+    for( int i=0; i<MaxBoardSize - 3; i++) {
+        pBest[ i] = kernelTable[ i];
+        useSimdRows( pBest[ i], simdSupported());
+    }
+    return pBest;
+}
+
+
+const BoardKernels &boardKernels( int squaresPerSide)
+{
+    static const BoardKernels *pBest = buildBestKernels();
+    return pBest[ kernelIndex( squaresPerSide)];
+}
+
+
+const BoardKernels &scalarBoardKernels( int squaresPerSide)
+{
+    return kernelTable[ kernelIndex( squaresPerSide)];
+}
+
+
+bool reportGameEnd( GameStatus status, int Tile)
+{
+    if( status == GameWon) {
+        std::cout << "Congratulations!  You made it to ";
+        std::cout << Tile << " !!!" <<std::endl;
+        return true;
+    }
+    if( status == GameNoMoves) {
+        std::cout << "\n";
+        std::cout << "No more available moves.  ";
+        std::cout << "Game is over.\n";
+        std::cout << "\n";
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,371 @@
+//
+// Board-size specialized versions of the move, compare and end-of-game functions.
+//
+// The functions in game.h take the number of squares per side as a runtime int, so the
+// compiler cannot unroll their loops.  The templates below take it as a template
+// parameter instead.  boardKernels() returns the set of instantiations for one board
+// size, so callers pick them once (after BoardSet chooses the size) and then call
+// through the returned function pointers for every move.
+//
+#ifndef BOARDKERNELS_H
+#define BOARDKERNELS_H
+
+#include <cstddef>           // For NULL
+#include "game.h"
+
+
+// Result of the end-of-game check
+enum GameStatus
+{
+    GameContinues,   // there is still a move to make
+    GameWon,         // the winning tile is on the board
+    GameNoMoves      // the board is full and no two neighbours match
+};
+
+
+// What a move did, so callers need not copy and compare the board to find out whether
+// it moved, and the end of the game can be tracked without scanning the board: the
+// squares freed by combining tiles, and the values of the combined tiles OR'd
+// together, so the move made tile T exactly when (made & T) != 0.
+struct MoveResult
+{
+    int merged;
+    int made;
+    bool changed;    // some tile slid or combined
+};
+
+
+// One bit per direction, for the set of moves that change a board
+const int MoveUp = 1;      // 'w'
+const int MoveLeft = 2;    // 'a'
+const int MoveDown = 4;    // 's'
+const int MoveRight = 8;   // 'd'
+
+inline int directionBit( char direction)
+{
+    switch( direction) {
+        case 'w': return MoveUp;
+        case 'a': return MoveLeft;
+        case 's': return MoveDown;
+        case 'd': return MoveRight;
+    }
+    return 0;
+}
+
+
+// Where one tile went in a move: from square source to square destination, indexed as in
+// the int[] board, combining there with the tile that arrived first if merged is set.
+// Tiles that stay where they are have source equal to destination.
+struct TileMotion
+{
+    unsigned char source;
+    unsigned char destination;
+    bool merged;
+};
+
+// The motions of every tile on the board in one move, for animating it
+struct MoveMotions
+{
+    int count;
+    TileMotion motions[ MaxBoardSize * MaxBoardSize];
+};
+
+
+// Counts kept up to date as the game is played, from which gameStatusFrom decides
+// whether the game is over without looking at the board while there are empty squares
+struct BoardSummary
+{
+    int empty;       // squares holding 0
+    int maxTile;     // largest value on the board
+};
+
+
+//--------------------------------------------------------------------
+// Slide the N squares line[0], line[Stride], ... line[(N-1)*Stride] toward line[0],
+// combining matching values at most once per move, so  2 2 4 4  becomes  4 8 0 0
+// as in Left1.  The combined values are added to score and recorded in result.
+// With Write false the line is only read, to find out whether the move would change it:
+// each square is read before anything is written to it, so the decisions are the same.
+// With Trace true each tile's motion is added to pMotions, line[0] being square first;
+// the moves the game engine runs without tracing compile to the same code as before.
+template <int N, int Stride, bool Write = true, bool Trace = false>
+inline void slideLine( int line[], int &score, MoveResult &result, MoveMotions *pMotions = NULL, int first = 0)
+{
+    int next = 0;       // position where the next tile will be placed
+    int pending = 0;    // value of the last placed tile if it can still combine, else 0
+    for( int i=0; i<N; i++) {
+        int value = line[ i*Stride];
+        if( value == 0) {
+            continue;
+        }
+        if( Write) {
+            line[ i*Stride] = 0;
+        }
+        if( value == pending) {
+            if( Write) {
+                line[ (next-1)*Stride] = value + value;
+            }
+            if( Trace) {
+                TileMotion motion = { (unsigned char)(first + i*Stride), (unsigned char)(first + (next-1)*Stride), true };
+                pMotions->motions[ pMotions->count++] = motion;
+            }
+            score += value + value;
+            result.merged++;
+            result.made |= value + value;
+            result.changed = true;
+            pending = 0;       // the combined tile cannot combine again on this move
+        }
+        else {
+            if( Write) {
+                line[ next*Stride] = value;
+            }
+            if( Trace) {
+                TileMotion motion = { (unsigned char)(first + i*Stride), (unsigned char)(first + next*Stride), false };
+                pMotions->motions[ pMotions->count++] = motion;
+            }
+            result.changed |= (next != i);
+            next++;
+            pending = value;
+        }
+    }
+}
+
+
+template <int N>
+MoveResult slideRightN( int play[], int &score)
+{
+    MoveResult result = { 0, 0, false };
+    for( int row=0; row<N; row++) {
+        slideLine<N, -1>( play + row*N + N-1, score, result);
+    }
+    return result;
+}
+
+
+template <int N>
+MoveResult Left1N( int game[], int &score)
+{
+    MoveResult result = { 0, 0, false };
+    for( int row=0; row<N; row++) {
+        slideLine<N, 1>( game + row*N, score, result);
+    }
+    return result;
+}
+
+
+template <int N>
+MoveResult Up1N( int board[], int &score)
+{
+    MoveResult result = { 0, 0, false };
+    for( int col=0; col<N; col++) {
+        slideLine<N, N>( board + col, score, result);
+    }
+    return result;
+}
+
+
+template <int N>
+MoveResult Down1N( int play[], int &score)
+{
+    MoveResult result = { 0, 0, false };
+    for( int col=0; col<N; col++) {
+        slideLine<N, -N>( play + (N-1)*N + col, score, result);
+    }
+    return result;
+}
+
+
+// Any of the four moves, also listing where every tile went
+template <int N>
+MoveResult traceMoveN( int board[], char direction, int &score, MoveMotions &motions)
+{
+    MoveResult result = { 0, 0, false };
+    motions.count = 0;
+    for( int k=0; k<N; k++) {
+        switch( direction) {
+            case 'w': slideLine<N, N, true, true>( board + k, score, result, &motions, k);                            break;
+            case 'a': slideLine<N, 1, true, true>( board + k*N, score, result, &motions, k*N);                        break;
+            case 's': slideLine<N, -N, true, true>( board + (N-1)*N + k, score, result, &motions, (N-1)*N + k);      break;
+            case 'd': slideLine<N, -1, true, true>( board + k*N + N-1, score, result, &motions, k*N + N-1);          break;
+        }
+    }
+    return result;
+}
+
+
+// The directions that would change the board, as MoveUp | MoveLeft | ..., found with
+// the same line kernel as the moves but without changing the board
+template <int N>
+int legalMovesN( const int play[])
+{
+    int *pLines = const_cast<int *>( play);   // only read, with Write false
+    int score = 0;
+    MoveResult up = { 0, 0, false }, left = up, down = up, right = up;
+    for( int k=0; k<N; k++) {
+        slideLine<N, N, false>( pLines + k, score, up);
+        slideLine<N, 1, false>( pLines + k*N, score, left);
+        slideLine<N, -N, false>( pLines + (N-1)*N + k, score, down);
+        slideLine<N, -1, false>( pLines + k*N + N-1, score, right);
+    }
+    return (up.changed ? MoveUp : 0) | (left.changed ? MoveLeft : 0)
+         | (down.changed ? MoveDown : 0) | (right.changed ? MoveRight : 0);
+}
+
+
+template <int N>
+void duplicateN( int BoardOld[], int play[])
+{
+    for( int i=0; i<N*N; i++) {
+        BoardOld[ i] = play[ i];
+    }
+}
+
+
+// Returning true if boards are different or false.
+template <int N>
+bool Board1N( int BoardOld[], int play[])
+{
+    bool changed = false;
+    for( int i=0; i<N*N; i++) {
+        changed |= (BoardOld[ i] != play[ i]);
+    }
+    return changed;
+}
+
+
+// True if any two neighbours, across or down, hold the same value.  On a full board
+// that is exactly when some move is possible.  One pass with no early exits, which
+// the compiler can vectorize.
+template <int N>
+bool hasPairsN( const int play[])
+{
+    int pairs = 0;
+    for( int row=0; row<N; row++) {
+        for( int col=0; col<N-1; col++) {
+            pairs |= (play[ row*N + col] == play[ row*N + col+1]);
+        }
+    }
+    for( int i=0; i<(N-1)*N; i++) {
+        pairs |= (play[ i] == play[ i+N]);
+    }
+    return pairs != 0;
+}
+
+
+// Same decision as gameEnds, without printing and without copying the board, in one
+// pass over the board: a full board still has a move exactly when two neighbours match.
+template <int N>
+GameStatus gameStatusN( int play[], int Tile)
+{
+    int won = 0;
+    int empty = 0;
+    for( int i=0; i<N*N; i++) {
+        won |= (play[ i] >= Tile);
+        empty |= (play[ i] == 0);
+    }
+    if( won) {
+        return GameWon;
+    }
+    if( empty || hasPairsN<N>( play)) {
+        return GameContinues;
+    }
+    return GameNoMoves;
+}
+
+
+// Count the empty squares and find the largest tile, to start a BoardSummary
+template <int N>
+BoardSummary summarizeN( const int play[])
+{
+    BoardSummary summary = { 0, 0 };
+    for( int i=0; i<N*N; i++) {
+        summary.empty += (play[ i] == 0);
+        summary.maxTile = (play[ i] > summary.maxTile) ? play[ i] : summary.maxTile;
+    }
+    return summary;
+}
+
+
+//--------------------------------------------------------------------
+// The instantiations for one board size
+struct BoardKernels
+{
+    int squaresPerSide;
+    MoveResult (*slideRight)( int play[], int &score);
+    MoveResult (*Left1)( int game[], int &score);
+    MoveResult (*Up1)( int board[], int &score);
+    MoveResult (*Down1)( int play[], int &score);
+    void (*duplicate)( int BoardOld[], int play[]);
+    bool (*Board1)( int BoardOld[], int play[]);
+    GameStatus (*gameStatus)( int play[], int Tile);
+    bool (*hasPairs)( const int play[]);
+    BoardSummary (*summarize)( const int play[]);
+    int (*legalMoves)( const int play[]);
+    MoveResult (*traceMove)( int board[], char direction, int &score, MoveMotions &motions);
+};
+
+// Slide the board in direction 'w', 'a', 's' or 'd', as in main()
+inline MoveResult applyMove( const BoardKernels &kernels, int board[], char direction, int &score)
+{
+    switch( direction) {
+        case 'w': return kernels.Up1( board, score);
+        case 'a': return kernels.Left1( board, score);
+        case 's': return kernels.Down1( board, score);
+        case 'd': return kernels.slideRight( board, score);
+    }
+    MoveResult none = { 0, 0, false };
+    return none;
+}
+
+// Same as applyMove, also filling in pMotions with where every tile went unless it is
+// NULL.  Only callers that animate the moves pass motions; without them this is applyMove.
+inline MoveResult applyMove( const BoardKernels &kernels, int board[], char direction, int &score,
+                             MoveMotions *pMotions)
+{
+    if( pMotions == NULL) {
+        return applyMove( kernels, board, direction, score);
+    }
+    return kernels.traceMove( board, direction, score, *pMotions);
+}
+
+// Bring a summary up to date after a move, and after a new piece is placed
+inline void summarizeMove( BoardSummary &summary, const MoveResult &move)
+{
+    summary.empty += move.merged;
+    if( move.made != 0) {
+        int largest = 1 << (31 - __builtin_clz( move.made));
+        summary.maxTile = (largest > summary.maxTile) ? largest : summary.maxTile;
+    }
+}
+
+inline void summarizeSpawn( BoardSummary &summary, int value)
+{
+    summary.empty--;
+    summary.maxTile = (value > summary.maxTile) ? value : summary.maxTile;
+}
+
+// Same decision as gameStatus, taken from the summary in O(1) while the board has an
+// empty square, and with one hasPairs pass once it is full
+inline GameStatus gameStatusFrom( const BoardKernels &kernels, const int board[],
+                                  const BoardSummary &summary, int Tile)
+{
+    if( summary.maxTile >= Tile) {
+        return GameWon;
+    }
+    if( summary.empty > 0 || kernels.hasPairs( board)) {
+        return GameContinues;
+    }
+    return GameNoMoves;
+}
+
+// Kernels for a board size between 4 and MaxBoardSize.  On large boards the moves use
+// the SSE4.1 or AVX2 row kernels in simdrows.h when the CPU has them.
+const BoardKernels &boardKernels( int squaresPerSide);
+
+// The unrolled scalar kernels only, for comparison
+const BoardKernels &scalarBoardKernels( int squaresPerSide);
+
+// Print the same end-of-game messages as gameEnds, returning true if the game is over
+bool reportGameEnd( GameStatus status, int Tile);
+
+#endif
@@ -0,0 +1,466 @@
+//
+// Packed board keys.  See boardkey.h for the layout.
+//
+#include "boardkey.h"
+#include <iostream>          // For cout, endl
+#include "bitboard.h"
+
+
+//--------------------------------------------------------------------
+// log2 of a tile, and 0 for an empty square, without a branch to mispredict
+static int exponentOf( int value)
+{
+    return 31 - __builtin_clz( value | 1);
+}
+
+
+// Square that (row, col) goes to when the board is turned by symmetry
+static int symmetricSquare( int row, int col, int squaresPerSide, int symmetry)
+{
+    if( symmetry & 1) {
+        int swap = row;
+        row = col;
+        col = swap;
+    }
+    if( symmetry & 2) {
+        row = squaresPerSide - 1 - row;
+    }
+    if( symmetry & 4) {
+        col = squaresPerSide - 1 - col;
+    }
+    return row * squaresPerSide + col;
+}
+
+
+// For every board size, the key layout, and for every symmetry, the square of the
+// original board that each square of the turned board comes from.  Built once, on
+// first use, and shared by all threads.
+struct KeyTables
+{
+    int bits[ MaxBoardSize + 1];
+    int words[ MaxBoardSize + 1];
+    unsigned char source[ MaxBoardSize + 1][ BoardSymmetries][ MaxBoardSize * MaxBoardSize];
+
+    KeyTables()
+    {
+        for( int n=1; n<=MaxBoardSize; n++) {
+            bits[ n] = (winningTile( n) <= (1 << 15)) ? 4 : 5;
+            words[ n] = (n*n + 64/bits[ n] - 1) / (64/bits[ n]);
+            for( int s=0; s<BoardSymmetries; s++) {
+                for( int row=0; row<n; row++) {
+                    for( int col=0; col<n; col++) {
+                        source[ n][ s][ symmetricSquare( row, col, n, s)] = row*n + col;
+                    }
+                }
+            }
+        }
+    }
+};
+
+
+static const KeyTables &keyTables()
+{
+    static const KeyTables tables;
+    return tables;
+}
+
+
+static void keyExponents( const BoardKey &key, unsigned char exponents[])
+{
+    int bits = keyBits( key.size);
+    uint64_t mask = ((uint64_t)1 << bits) - 1;
+    int square = 0;
+    for( int w=0; square < key.size * key.size; w++) {
+        uint64_t word = key.words[ w];
+        for( int shift=0; shift+bits<=64 && square < key.size * key.size; shift+=bits) {
+            exponents[ square++] = (word >> shift) & mask;
+        }
+    }
+}
+
+
+// One word of a key, packed from the exponents of the squares listed in source
+static uint64_t gatherWord( const unsigned char exponents[], const unsigned char source[],
+                            int word, int bits, int cells)
+{
+    int first = word * (64 / bits);
+    int last = (first + 64 / bits < cells) ? first + 64 / bits : cells;
+    uint64_t packed = 0;
+    for( int square=first; square<last; square++) {
+        packed |= (uint64_t)exponents[ source[ square]] << ((square - first) * bits);
+    }
+    return packed;
+}
+
+
+// Pack the exponents into key, taking square i of the board from exponents[ source[ i]]
+static void packExponents( BoardKey &key, const unsigned char exponents[], const unsigned char source[],
+                           int squaresPerSide)
+{
+    key.size = squaresPerSide;
+    for( int w=0; w<keyWords( squaresPerSide); w++) {
+        key.words[ w] = gatherWord( exponents, source, w, keyBits( squaresPerSide), squaresPerSide * squaresPerSide);
+    }
+}
+
+
+static uint64_t mixBits( uint64_t x)
+{
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+
+//--------------------------------------------------------------------
+int keyBits( int squaresPerSide)
+{
+    return keyTables().bits[ squaresPerSide];
+}
+
+
+int keyWords( int squaresPerSide)
+{
+    return keyTables().words[ squaresPerSide];
+}
+
+
+uint64_t boardKey4( const int play[])
+{
+    uint64_t key = 0;
+    for( int i=0; i<16; i++) {
+        key |= (uint64_t)exponentOf( play[ i]) << (4*i);
+    }
+    return key;
+}
+
+
+void boardKey4ToArray( uint64_t key, int play[])
+{
+    for( int i=0; i<16; i++) {
+        int e = (key >> (4*i)) & 0xF;
+        play[ i] = (e == 0) ? 0 : (1 << e);
+    }
+}
+
+
+void boardKeyFromArray( BoardKey &key, const int play[], int squaresPerSide)
+{
+    if( squaresPerSide == 4) {
+        key.size = 4;
+        key.words[ 0] = boardKey4( play);
+        return;
+    }
+    int bits = keyBits( squaresPerSide);
+    int cells = squaresPerSide * squaresPerSide;
+    key.size = squaresPerSide;
+    for( int w=0, square=0; square<cells; w++) {
+        int last = (square + 64 / bits < cells) ? square + 64 / bits : cells;
+        uint64_t word = 0;
+        for( int shift=0; square<last; square++, shift+=bits) {
+            word |= (uint64_t)exponentOf( play[ square]) << shift;
+        }
+        key.words[ w] = word;
+    }
+}
+
+
+void boardKeyToArray( const BoardKey &key, int play[])
+{
+    if( key.size == 4) {
+        boardKey4ToArray( key.words[ 0], play);
+        return;
+    }
+    unsigned char exponents[ MaxBoardSize * MaxBoardSize];
+    keyExponents( key, exponents);
+    for( int i=0; i<key.size * key.size; i++) {
+        play[ i] = (exponents[ i] == 0) ? 0 : (1 << exponents[ i]);
+    }
+}
+
+
+bool boardKeyEqual( const BoardKey &a, const BoardKey &b)
+{
+    if( a.size != b.size) {
+        return false;
+    }
+    for( int w=0; w<keyWords( a.size); w++) {
+        if( a.words[ w] != b.words[ w]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+bool boardKeyLess( const BoardKey &a, const BoardKey &b)
+{
+    if( a.size != b.size) {
+        return a.size < b.size;
+    }
+    for( int w=0; w<keyWords( a.size); w++) {
+        if( a.words[ w] != b.words[ w]) {
+            return a.words[ w] < b.words[ w];
+        }
+    }
+    return false;
+}
+
+
+//--------------------------------------------------------------------
+// Turn the rows of a 4x4 key upside down, and mirror each row, with shifts and masks
+static uint64_t flipRows4( uint64_t key)
+{
+    key = (key << 32) | (key >> 32);
+    return ((key & 0x0000FFFF0000FFFFULL) << 16) | ((key >> 16) & 0x0000FFFF0000FFFFULL);
+}
+
+
+static uint64_t mirrorRows4( uint64_t key)
+{
+    key = ((key & 0x00FF00FF00FF00FFULL) << 8) | ((key >> 8) & 0x00FF00FF00FF00FFULL);
+    return ((key & 0x0F0F0F0F0F0F0F0FULL) << 4) | ((key >> 4) & 0x0F0F0F0F0F0F0F0FULL);
+}
+
+
+uint64_t boardKey4Symmetry( uint64_t key, int symmetry)
+{
+    if( symmetry & 1) {
+        key = bitboardTranspose4( key);
+    }
+    if( symmetry & 2) {
+        key = flipRows4( key);
+    }
+    if( symmetry & 4) {
+        key = mirrorRows4( key);
+    }
+    return key;
+}
+
+
+void boardKeySymmetry( const BoardKey &key, int symmetry, BoardKey &turned)
+{
+    if( key.size == 4) {
+        turned.size = 4;
+        turned.words[ 0] = boardKey4Symmetry( key.words[ 0], symmetry);
+        return;
+    }
+    unsigned char exponents[ MaxBoardSize * MaxBoardSize];
+    keyExponents( key, exponents);
+    packExponents( turned, exponents, keyTables().source[ key.size][ symmetry], key.size);
+}
+
+
+int canonicalBoardKey4( uint64_t key, uint64_t &canonical)
+{
+    // Each symmetry is one step from a symmetry already worked out
+    uint64_t turned[ BoardSymmetries];
+    turned[ 0] = key;
+    turned[ 1] = bitboardTranspose4( key);
+    turned[ 2] = flipRows4( turned[ 0]);
+    turned[ 3] = flipRows4( turned[ 1]);
+    for( int s=4; s<BoardSymmetries; s++) {
+        turned[ s] = mirrorRows4( turned[ s-4]);
+    }
+    int best = 0;
+    for( int s=1; s<BoardSymmetries; s++) {
+        if( turned[ s] < turned[ best]) {
+            best = s;
+        }
+    }
+    canonical = turned[ best];
+    return best;
+}
+
+
+int canonicalBoardKey( const BoardKey &key, BoardKey &canonical)
+{
+    if( key.size == 4) {
+        canonical.size = 4;
+        return canonicalBoardKey4( key.words[ 0], canonical.words[ 0]);
+    }
+    const KeyTables &tables = keyTables();
+    int bits = tables.bits[ key.size];
+    int words = tables.words[ key.size];
+    int cells = key.size * key.size;
+    unsigned char exponents[ MaxBoardSize * MaxBoardSize];
+    keyExponents( key, exponents);
+    canonical = key;
+
+    // Pack each turned key a word at a time, dropping it at the first word that is
+    // greater than the best so far, which for most boards is the first
+    int best = 0;
+    for( int s=1; s<BoardSymmetries; s++) {
+        const unsigned char *pSource = tables.source[ key.size][ s];
+        BoardKey turned;
+        bool less = false;
+        int w;
+        for( w=0; w<words; w++) {
+            turned.words[ w] = gatherWord( exponents, pSource, w, bits, cells);
+            if( !less && turned.words[ w] != canonical.words[ w]) {
+                if( turned.words[ w] > canonical.words[ w]) {
+                    break;
+                }
+                less = true;
+            }
+        }
+        if( less) {
+            for( w=0; w<words; w++) {
+                canonical.words[ w] = turned.words[ w];
+            }
+            best = s;
+        }
+    }
+    return best;
+}
+
+
+char symmetricDirection( char direction, int symmetry, bool inverse)
+{
+    int rowStep = (direction == 'w') ? -1 : (direction == 's') ? 1 : 0;
+    int colStep = (direction == 'a') ? -1 : (direction == 'd') ? 1 : 0;
+    for( int step=0; step<3; step++) {
+        int bit = inverse ? 4 >> step : 1 << step;   // undo the steps in reverse order
+        if( (symmetry & bit) == 0) {
+            continue;
+        }
+        if( bit == 1) {
+            int swap = rowStep;
+            rowStep = colStep;
+            colStep = swap;
+        }
+        else if( bit == 2) {
+            rowStep = -rowStep;
+        }
+        else {
+            colStep = -colStep;
+        }
+    }
+    if( rowStep != 0) {
+        return (rowStep < 0) ? 'w' : 's';
+    }
+    return (colStep < 0) ? 'a' : 'd';
+}
+
+
+uint64_t boardKey4Hash( uint64_t key, uint64_t seed)
+{
+    return mixBits( (seed ^ (4 * 0x9E3779B97F4A7C15ULL)) ^ key);
+}
+
+
+uint64_t boardKeyHash( const BoardKey &key, uint64_t seed)
+{
+    uint64_t hash = seed ^ (key.size * 0x9E3779B97F4A7C15ULL);
+    for( int w=0; w<keyWords( key.size); w++) {
+        hash = mixBits( hash ^ key.words[ w]);
+    }
+    return hash;
+}
+
+
+//--------------------------------------------------------------------
+static void referenceMove( int play[], int squaresPerSide, char direction, int &score)
+{
+    switch( direction) {
+        case 'w': Up1( play, squaresPerSide, score);        break;
+        case 'a': Left1( play, squaresPerSide, score);      break;
+        case 's': Down1( play, squaresPerSide, score);      break;
+        case 'd': slideRight( play, squaresPerSide, score); break;
+    }
+}
+
+
+static void turnArray( const int play[], int squaresPerSide, int symmetry, int turned[])
+{
+    for( int row=0; row<squaresPerSide; row++) {
+        for( int col=0; col<squaresPerSide; col++) {
+            turned[ symmetricSquare( row, col, squaresPerSide, symmetry)] = play[ row*squaresPerSide + col];
+        }
+    }
+}
+
+
+static bool reportMismatch( const char *what, int play[], int squaresPerSide, int symmetry)
+{
+    std::cout << "Board key mismatch on " << squaresPerSide << "x" << squaresPerSide
+              << " board, " << what << ", symmetry " << symmetry << std::endl;
+    BoardVisual( play, squaresPerSide, 0);
+    return false;
+}
+
+
+bool boardKeysMatchReference( int positions, unsigned seed)
+{
+    const char directions[] = { 'w', 'a', 's', 'd' };
+    GameRng rng( seed);
+
+    for( int squaresPerSide=4; squaresPerSide<=MaxBoardSize; squaresPerSide++) {
+        int cells = squaresPerSide * squaresPerSide;
+        int maxExponent = exponentOf( winningTile( squaresPerSide));
+        for( int p=0; p<positions; p++) {
+            // Mostly small tiles so that moves combine some, with a few up to the winning tile
+            int play[ MaxBoardSize * MaxBoardSize];
+            for( int i=0; i<cells; i++) {
+                int e = (rng.below( 8) == 0) ? rng.below( maxExponent + 1) : rng.below( 4);
+                play[ i] = (e == 0) ? 0 : (1 << e);
+            }
+
+            BoardKey key, canonical;
+            int back[ MaxBoardSize * MaxBoardSize];
+            boardKeyFromArray( key, play, squaresPerSide);
+            boardKeyToArray( key, back);
+            if( Board1( back, play, squaresPerSide)) {
+                return reportMismatch( "unpacked board", play, squaresPerSide, 0);
+            }
+            BitBoard bits;
+            bitboardFromArray( bits, play, squaresPerSide);
+            if( squaresPerSide == 4 && (key.words[ 0] != bits.words[ 0] || key.words[ 0] != boardKey4( play))) {
+                return reportMismatch( "4x4 key", play, squaresPerSide, 0);
+            }
+            int symmetry = canonicalBoardKey( key, canonical);
+            uint64_t hash = boardKeyHash( canonical);
+
+            for( int s=0; s<BoardSymmetries; s++) {
+                // The key of the turned board is the turned key, with the same canonical form
+                int turned[ MaxBoardSize * MaxBoardSize];
+                turnArray( play, squaresPerSide, s, turned);
+                BoardKey turnedKey, expected, turnedCanonical;
+                boardKeyFromArray( expected, turned, squaresPerSide);
+                boardKeySymmetry( key, s, turnedKey);
+                if( !boardKeyEqual( turnedKey, expected)) {
+                    return reportMismatch( "turned key", play, squaresPerSide, s);
+                }
+                int turnedSymmetry = canonicalBoardKey( turnedKey, turnedCanonical);
+                BoardKey check;
+                boardKeySymmetry( turnedKey, turnedSymmetry, check);
+                if( !boardKeyEqual( turnedCanonical, canonical) || !boardKeyEqual( check, canonical)
+                    || boardKeyHash( turnedCanonical) != hash) {
+                    return reportMismatch( "canonical key", play, squaresPerSide, s);
+                }
+
+                // Moving then turning gives the same board as turning then making the turned move
+                char direction = directions[ rng.below( 4)];
+                char turnedDirection = symmetricDirection( direction, s);
+                int moved[ MaxBoardSize * MaxBoardSize];
+                int movedTurned[ MaxBoardSize * MaxBoardSize];
+                int score = 0;
+                int turnedScore = 0;
+                duplicate( moved, play, squaresPerSide);
+                referenceMove( moved, squaresPerSide, direction, score);
+                turnArray( moved, squaresPerSide, s, movedTurned);
+                referenceMove( turned, squaresPerSide, turnedDirection, turnedScore);
+                if( Board1( turned, movedTurned, squaresPerSide) || score != turnedScore
+                    || symmetricDirection( turnedDirection, s, true) != direction) {
+                    return reportMismatch( "turned move", play, squaresPerSide, s);
+                }
+            }
+            BoardKey check;
+            boardKeySymmetry( key, symmetry, check);
+            if( !boardKeyEqual( check, canonical)) {
+                return reportMismatch( "canonical symmetry", play, squaresPerSide, symmetry);
+            }
+        }
+    }
+    return true;
+}
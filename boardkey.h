@@ -0,0 +1,80 @@
+//
+// Packed board keys: compact, comparable and hashable copies of a position.
+//
+// A key holds the log2 exponent of every square (0 for an empty square, 1 for a 2, and
+// so on), packed in order from square 0 into 64-bit words, low bits first.  Squares
+// take four bits wherever the winning tile fits in them, which is every size up to 9x9,
+// so a 4x4 board is one word laid out exactly like the bitboard engine's, and a 9x9 board
+// six.  The 10x10 to 12x12 boards need five bits for their 2^16 to 2^18 winning tiles and
+// take 9 to 12 words.  Two keys are equal exactly when their boards are, and comparing
+// them costs a few word compares instead of a walk over every square as in Board1.
+//
+// Each of the eight rotations and reflections of a board plays the same game, with the
+// moves turned to match.  canonicalBoardKey picks the same one of the eight for all of
+// them, so positions can be deduplicated in histories, caches and transposition tables
+// whichever way round they were reached.
+//
+#ifndef BOARDKEY_H
+#define BOARDKEY_H
+
+#include <cstdint>
+#include "game.h"
+
+
+const int MaxKeyWords = 12;        // words in the key of a 12x12 board
+const int BoardSymmetries = 8;
+
+
+struct BoardKey
+{
+    uint64_t words[ MaxKeyWords];  // only the first keyWords( size) are used
+    int size;                      // squares per side
+};
+
+
+// Bits per square, and words per key, for a board size; keyWords( n) * 8 is the bytes
+// needed to store one position
+int keyBits( int squaresPerSide);
+int keyWords( int squaresPerSide);
+
+// Convert between the int[] board and its key.  Tile values must be powers of two that
+// fit in keyBits( squaresPerSide) bits as exponents.
+void boardKeyFromArray( BoardKey &key, const int play[], int squaresPerSide);
+void boardKeyToArray( const BoardKey &key, int play[]);
+
+// Same as boardKeyFromArray and boardKeyToArray, for a 4x4 board held in a single word
+uint64_t boardKey4( const int play[]);
+void boardKey4ToArray( uint64_t key, int play[]);
+
+bool boardKeyEqual( const BoardKey &a, const BoardKey &b);
+
+// True if a orders before b.  Any keys of the same size are ordered, so keys can be
+// sorted and searched.
+bool boardKeyLess( const BoardKey &a, const BoardKey &b);
+
+// Turn the board by one of the eight symmetries: bit 0 of symmetry swaps rows and
+// columns, then bit 1 turns the board upside down and bit 2 mirrors it left to right.
+// Symmetry 0 leaves the board as it is.
+void boardKeySymmetry( const BoardKey &key, int symmetry, BoardKey &turned);
+uint64_t boardKey4Symmetry( uint64_t key, int symmetry);
+
+// The least of the eight turned keys, which is the same for every rotation and
+// reflection of the board.  Returns the symmetry that turns key into canonical.
+int canonicalBoardKey( const BoardKey &key, BoardKey &canonical);
+int canonicalBoardKey4( uint64_t key, uint64_t &canonical);
+
+// The direction a move goes in on the board turned by symmetry, or with inverse set,
+// the direction on the original board of a move on the turned one
+char symmetricDirection( char direction, int symmetry, bool inverse = false);
+
+// 64-bit hash of a key, with every bit depending on every square.  Different seeds give
+// independent hashes, so two can be used together where one might collide.
+uint64_t boardKeyHash( const BoardKey &key, uint64_t seed = 0);
+uint64_t boardKey4Hash( uint64_t key, uint64_t seed = 0);
+
+// Check packing, unpacking, the symmetries and the canonical form on every board size
+// against the int[] board, using random positions.  Prints any mismatch and returns
+// false if one is found.
+bool boardKeysMatchReference( int positions, unsigned seed);
+
+#endif
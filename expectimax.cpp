@@ -0,0 +1,444 @@
+//
+// Expectimax player.  See expectimax.h.
+//
+#include "expectimax.h"
+#include <algorithm>         // For max()
+#include <chrono>            // For steady_clock
+#include <cmath>             // For pow()
+#include <cstring>           // For memcpy()
+#include <functional>
+#include "game.h"
+#include "bitboard.h"
+#include "boardkernels.h"
+#include "threadpool.h"
+
+
+const char SearchOrder[] = { 'w', 'a', 's', 'd' };
+
+const int MaxDepth = 6;                    // moves looked ahead at most
+const double NodeBudget = 200000;          // rough number of nodes a search may expand
+const float ProbabilityCutoff = 0.0001f;   // chance positions less likely than this are not expanded
+const long CancelCheckNodes = 256;         // nodes searched between checks for cancelling
+
+// Heuristic weights.  Every row and column is scored on its own and the scores summed.
+const float LostPenalty = 200000.0f;       // base score, so that any live position beats a lost one
+const float EmptyWeight = 270.0f;
+const float MergesWeight = 700.0f;
+const float MonotonicityPower = 4.0f;
+const float MonotonicityWeight = 47.0f;
+const float SumPower = 3.5f;
+const float SumWeight = 11.0f;
+
+
+//--------------------------------------------------------------------
+// Powers of every exponent used by the heuristic, computed once
+struct HeuristicPowers
+{
+    float sum[ 32];
+    float monotonicity[ 32];
+
+    HeuristicPowers()
+    {
+        for( int rank=0; rank<32; rank++) {
+            sum[ rank] = pow( rank, SumPower);
+            monotonicity[ rank] = pow( rank, MonotonicityPower);
+        }
+    }
+};
+
+
+// Heuristic for one row or column of exponents
+static float lineHeuristic( const int line[], int n)
+{
+    static const HeuristicPowers powers;
+    float sum = 0;
+    int empty = 0;
+    int merges = 0;
+    int previous = 0;
+    int run = 0;        // matching neighbours in the current run
+    for( int i=0; i<n; i++) {
+        int rank = line[ i];
+        sum += powers.sum[ rank];
+        if( rank == 0) {
+            empty++;
+            continue;
+        }
+        if( previous == rank) {
+            run++;
+        }
+        else if( run > 0) {
+            merges += 1 + run;
+            run = 0;
+        }
+        previous = rank;
+    }
+    if( run > 0) {
+        merges += 1 + run;
+    }
+
+    // Penalize the smaller of the two ways the line fails to be monotone
+    float towardStart = 0;
+    float towardEnd = 0;
+    for( int i=1; i<n; i++) {
+        float before = powers.monotonicity[ line[ i-1]];
+        float after = powers.monotonicity[ line[ i]];
+        if( line[ i-1] > line[ i]) {
+            towardStart += before - after;
+        }
+        else {
+            towardEnd += after - before;
+        }
+    }
+    float monotonicity = (towardStart < towardEnd) ? towardStart : towardEnd;
+
+    return LostPenalty + EmptyWeight * empty + MergesWeight * merges
+         - MonotonicityWeight * monotonicity - SumWeight * sum;
+}
+
+
+// Heuristic for every 16-bit row of a 4x4 board
+static const float *buildRowHeuristics()
+{
+    float *pTable = new float[ 65536];
+    for( int row=0; row<65536; row++) {
+        int line[ 4];
+        for( int c=0; c<4; c++) {
+            line[ c] = (row >> (4*c)) & 0xF;
+        }
+        pTable[ row] = lineHeuristic( line, 4);
+    }
+    return pTable;
+}
+
+
+static float evaluate( const BitBoard &bits)
+{
+    if( bits.size == 4) {
+        static const float *pRows = buildRowHeuristics();
+        uint64_t columns = bitboardTranspose4( bits.words[ 0]);
+        float value = 0;
+        for( int r=0; r<4; r++) {
+            value += pRows[ (bits.words[ 0] >> (16*r)) & 0xFFFF];
+            value += pRows[ (columns >> (16*r)) & 0xFFFF];
+        }
+        return value;
+    }
+
+    int n = bits.size;
+    float value = 0;
+    for( int r=0; r<n; r++) {
+        int row[ MaxBoardSize];
+        int column[ MaxBoardSize];
+        for( int c=0; c<n; c++) {
+            row[ c] = bitboardGet( bits, r*n + c);
+            column[ c] = bitboardGet( bits, c*n + r);
+        }
+        value += lineHeuristic( row, n) + lineHeuristic( column, n);
+    }
+    return value;
+}
+
+
+//--------------------------------------------------------------------
+// Transposition table shared by every search in the process.  Entries are written
+// without locks: check holds key ^ data, so an entry torn by two threads writing at
+// once fails the key test instead of returning a wrong value.
+const int TableBits = 20;
+
+struct TableEntry
+{
+    std::atomic<uint64_t> check;
+    std::atomic<uint64_t> data;    // value's float bits in the high half, depth in the low
+};
+
+
+static TableEntry *transpositionTable()
+{
+    static TableEntry *pTable = new TableEntry[ 1 << TableBits]();
+    return pTable;
+}
+
+
+static uint64_t mixBits( uint64_t x)
+{
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+
+// The rows hashed together, starting from the board size, since boards of every size
+// share the table.  mixBits is one to one, so a 4x4 board, one word, still has a key
+// of its own.
+static uint64_t boardKey( const BitBoard &bits)
+{
+    uint64_t key = bits.size;
+    for( int r=0; r<bits.size; r++) {
+        key = mixBits( key ^ bits.words[ r]);
+    }
+    return key;
+}
+
+
+static bool lookup( uint64_t key, int depth, float &value)
+{
+    TableEntry &entry = transpositionTable()[ mixBits( key) & ((1 << TableBits) - 1)];
+    uint64_t data = entry.data.load( std::memory_order_relaxed);
+    uint64_t check = entry.check.load( std::memory_order_relaxed);
+    if( (check ^ data) != key || (int)(data & 0xFF) < depth) {
+        return false;
+    }
+    uint32_t valueBits = (uint32_t)(data >> 32);
+    memcpy( &value, &valueBits, sizeof( value));
+    return true;
+}
+
+
+static void store( uint64_t key, int depth, float value)
+{
+    TableEntry &entry = transpositionTable()[ mixBits( key) & ((1 << TableBits) - 1)];
+    uint32_t valueBits;
+    memcpy( &valueBits, &value, sizeof( value));
+    uint64_t data = ((uint64_t)valueBits << 32) | (uint64_t)depth;
+    entry.data.store( data, std::memory_order_relaxed);
+    entry.check.store( key ^ data, std::memory_order_relaxed);
+}
+
+
+//--------------------------------------------------------------------
+// One search, run by one thread.  A search that is cancelled returns 0 from every node
+// from then on, and stores nothing in the transposition table.
+struct Search
+{
+    long nodes;
+    long lookups;
+    long hits;
+    const std::atomic<bool> *pCancel;
+    long nextCheck;    // nodes at which to check pCancel again
+    bool cancelled;
+
+    Search() : nodes( 0), lookups( 0), hits( 0), pCancel( NULL), nextCheck( 0), cancelled( false) {}
+
+    // Best value over the moves that change the board, or 0 if none does
+    float maxNode( const BitBoard &bits, int depth, float probability)
+    {
+        if( depth == 0) {
+            nodes++;
+            return evaluate( bits);
+        }
+        float best = 0;
+        for( int d=0; d<4; d++) {
+            BitBoard moved = bits;
+            int score = 0;
+            bitboardMove( moved, SearchOrder[ d], score);
+            if( !bitboardEqual( moved, bits)) {
+                float value = chanceNode( moved, depth, probability);
+                if( value > best) {
+                    best = value;
+                }
+            }
+        }
+        return best;
+    }
+
+    // Average over every empty square receiving a 2 or a 4, each with chance one half
+    float chanceNode( const BitBoard &bits, int depth, float probability)
+    {
+        nodes++;
+        if( pCancel != NULL && nodes >= nextCheck) {
+            nextCheck = nodes + CancelCheckNodes;
+            cancelled = cancelled || pCancel->load( std::memory_order_relaxed);
+        }
+        if( cancelled) {
+            return 0;
+        }
+        if( probability < ProbabilityCutoff) {
+            return evaluate( bits);
+        }
+
+        uint64_t key = boardKey( bits);
+        float value;
+        lookups++;
+        if( lookup( key, depth, value)) {
+            hits++;
+            return value;
+        }
+
+        int cells = bits.size * bits.size;
+        int empty = 0;
+        for( int i=0; i<cells; i++) {
+            empty += (bitboardGet( bits, i) == 0);
+        }
+        if( empty == 0) {
+            return evaluate( bits);
+        }
+
+        float sum = 0;
+        float childProbability = probability * 0.5f / empty;
+        for( int i=0; i<cells; i++) {
+            if( bitboardGet( bits, i) != 0) {
+                continue;
+            }
+            BitBoard child = bits;
+            bitboardSet( child, i, 1);
+            sum += 0.5f * maxNode( child, depth - 1, childProbability);
+            bitboardSet( child, i, 2);
+            sum += 0.5f * maxNode( child, depth - 1, childProbability);
+        }
+        value = sum / empty;
+        if( !cancelled) {
+            store( key, depth, value);
+        }
+        return value;
+    }
+};
+
+
+// Look further ahead as the board fills up and each chance position has fewer children
+static int searchDepth( int empty)
+{
+    double branching = 8.0 * (empty > 0 ? empty : 1);   // four moves, then two tiles per empty square
+    int depth = 1;
+    while( depth < MaxDepth && pow( branching, depth + 1) <= NodeBudget) {
+        depth++;
+    }
+    return depth;
+}
+
+
+// Search each of the four moves from root, in parallel on pPool if it is given.  values[ d]
+// is -1, below any reachable value, for a move that changes nothing.  Returns the index
+// of the best move, or -1 if there is none.
+static int searchRoot( const BitBoard &root, int depth, ThreadPool *pPool, Search searches[], float values[])
+{
+    std::function<void( int)> searchMove = [&]( int d) {
+        BitBoard moved = root;
+        int score = 0;
+        bitboardMove( moved, SearchOrder[ d], score);
+        values[ d] = -1;
+        if( !bitboardEqual( moved, root)) {
+            values[ d] = searches[ d].chanceNode( moved, depth, 1.0f);
+        }
+    };
+    if( pPool != NULL) {
+        pPool->parallelFor( 4, searchMove);
+    }
+    else {
+        for( int d=0; d<4; d++) {
+            searchMove( d);
+        }
+    }
+
+    int best = 0;
+    for( int d=1; d<4; d++) {
+        if( values[ d] > values[ best]) {
+            best = d;
+        }
+    }
+    return (values[ best] >= 0) ? best : -1;
+}
+
+
+// Add the counters of the four root searches to stats
+static void addSearches( const Search searches[], SearchStats &stats)
+{
+    for( int d=0; d<4; d++) {
+        stats.nodes += searches[ d].nodes;
+        stats.lookups += searches[ d].lookups;
+        stats.hits += searches[ d].hits;
+    }
+}
+
+
+// The first move in SearchOrder that changes the board, for a board the bitboard search
+// cannot hold
+static int firstLegalMove( const int board[], int squaresPerSide)
+{
+    int legal = boardKernels( squaresPerSide).legalMoves( board);
+    for( int d=0; d<4; d++) {
+        if( legal & directionBit( SearchOrder[ d])) {
+            return d;
+        }
+    }
+    return 0;
+}
+
+
+char searchBestMove( const int board[], int squaresPerSide, int depth, const std::atomic<bool> *pCancel,
+                     float &value, SearchStats &stats)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    stats = SearchStats();
+    if( !bitboardFits( board, squaresPerSide)) {
+        return 0;
+    }
+    BitBoard root;
+    bitboardFromArray( root, board, squaresPerSide);
+    float values[ 4];
+    Search searches[ 4];
+    for( int d=0; d<4; d++) {
+        searches[ d].pCancel = pCancel;
+    }
+    int best = searchRoot( root, depth, NULL, searches, values);
+
+    addSearches( searches, stats);
+    stats.seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start).count();
+    bool cancelled = searches[ 0].cancelled || searches[ 1].cancelled || searches[ 2].cancelled || searches[ 3].cancelled;
+    if( best < 0 || cancelled) {
+        return 0;
+    }
+    value = values[ best];
+    return SearchOrder[ best];
+}
+
+
+//--------------------------------------------------------------------
+ExpectimaxPolicy::ExpectimaxPolicy( ThreadPool *pPool)
+    : pPool( pPool), depth( 0), value( 0)
+{
+}
+
+
+// The search averages over every piece Random1 could place, so it draws nothing from rng
+char ExpectimaxPolicy::chooseMove( const int board[], int squaresPerSide, GameRng & /*rng*/)
+{
+    // Wall time of this move's search alone: while the pool runs the root moves, this
+    // thread helps with them and with nothing else
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    last = SearchStats();
+    if( !bitboardFits( board, squaresPerSide)) {
+        // A 4x4 tile past 16384 does not fit the search's bitboard, so play on without it
+        depth = 0;
+        value = 0;
+        return SearchOrder[ firstLegalMove( board, squaresPerSide)];
+    }
+    BitBoard root;
+    bitboardFromArray( root, board, squaresPerSide);
+    int empty = 0;
+    for( int i=0; i<squaresPerSide * squaresPerSide; i++) {
+        empty += (board[ i] == 0);
+    }
+    depth = searchDepth( empty);
+
+    float values[ 4];
+    Search searches[ 4];
+    int best = std::max( 0, searchRoot( root, depth, pPool, searches, values));
+
+    value = values[ best];
+    addSearches( searches, last);
+    last.seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start).count();
+    total.nodes += last.nodes;
+    total.lookups += last.lookups;
+    total.hits += last.hits;
+    total.seconds += last.seconds;
+    return SearchOrder[ best];
+}
+
+
+void ExpectimaxPolicy::addStats( SearchStats &totals) const
+{
+    totals.nodes += total.nodes;
+    totals.lookups += total.lookups;
+    totals.hits += total.hits;
+    totals.seconds += total.seconds;
+}
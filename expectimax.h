@@ -0,0 +1,51 @@
+//
+// Expectimax player.
+//
+// Searches the moves available on the board, averaging over every empty square and
+// over the 2 and 4 that Random1 places there with equal chance, and scores the
+// positions at the bottom of the search with a heuristic (empty squares, possible
+// merges, monotone rows and columns).  Positions are searched on the bitboard engine,
+// results are kept in a transposition table keyed by the packed board, the depth grows
+// as the board fills up, and the four root moves are searched in parallel.
+//
+#ifndef EXPECTIMAX_H
+#define EXPECTIMAX_H
+
+#include <atomic>
+#include "policy.h"
+
+
+class ExpectimaxPolicy : public MovePolicy
+{
+public:
+    // Root moves are searched in parallel on pPool, or one after another if it is NULL.
+    // A board the bitboard search cannot hold gets the first move that changes it.
+    explicit ExpectimaxPolicy( ThreadPool *pPool = NULL);
+
+    char chooseMove( const int board[], int squaresPerSide, GameRng &rng);
+    void addStats( SearchStats &totals) const;
+    double moveValue() const { return value; }
+
+    // Counters and depth of the most recent chooseMove.  Its seconds are the wall time
+    // from the start of that move's search to its end.
+    const SearchStats &lastSearch() const { return last; }
+    int lastDepth() const { return depth; }
+
+private:
+    ThreadPool *pPool;
+    SearchStats total;
+    SearchStats last;
+    int depth;
+    double value;
+};
+
+
+// Best move from the board searched to a fixed depth on the calling thread, for callers
+// such as the hint service that deepen the search themselves.  Sets the move's value and
+// the search's counters.  Returns 0 if no move changes the board, if the board has a
+// tile too large for the bitboard search (see bitboardFits), or if *pCancel was set
+// before the search finished; pCancel may be NULL.
+char searchBestMove( const int board[], int squaresPerSide, int depth, const std::atomic<bool> *pCancel,
+                     float &value, SearchStats &stats);
+
+#endif
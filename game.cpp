@@ -0,0 +1,357 @@
+//
+// Game engine for 1024: board setup, random tile placement, the four slide moves and
+// the end-of-game check.  These are the reference implementations that operate on the
+// int[] board used by the graphical client in main.cpp.  Undo and redo are kept by
+// UndoHistory in history.h.
+//
+#include "game.h"
+#include <iostream>          // For cin, cout, endl
+#include <iomanip>           // used for setting output field size using setw
+
+
+// Position of set bit number k (counting from 0) in word, found by halving the
+// word six times, so the cost does not depend on k
+static int selectBit( uint64_t word, int k)
+{
+    int position = 0;
+    for( int width=32; width>0; width/=2) {
+        uint64_t low = word & ((1ULL << width) - 1);
+        int count = __builtin_popcountll( low);
+        if( k >= count) {
+            k -= count;
+            word >>= width;
+            position += width;
+        }
+        else {
+            word = low;
+        }
+    }
+    return position;
+}
+
+
+int Random1( int game[], int shapes, GameRng &rng)
+{
+    
+    int Pos = 2;
+    if( rng.below( 2) == 1) {      // for randomly selecting 2 or 4
+        Pos = 4;
+    }
+    
+    // Mark the empty squares in a bit mask, then pick one of them directly, instead of
+    // drawing random squares until an empty one turns up
+    const int Words = (MaxBoardSize * MaxBoardSize + 63) / 64;
+    uint64_t empty[ Words] = { 0 };
+    for( int i=0; i<shapes*shapes; i++) {
+        empty[ i / 64] |= (uint64_t)(game[ i] == 0) << (i % 64);
+    }
+    int count = 0;
+    for( int w=0; w<Words; w++) {
+        count += __builtin_popcountll( empty[ w]);
+    }
+    if( count == 0) {
+        return -1;   // no empty square
+    }
+    
+    int k = rng.below( count);
+    int temp1 = 0;
+    for( int w=0; w<Words; w++) {
+        int inWord = __builtin_popcountll( empty[ w]);
+        if( k < inWord) {
+            temp1 = 64*w + selectBit( empty[ w], k);
+            break;
+        }
+        k -= inWord;
+    }
+    
+    // blank index position
+    game[ temp1] = Pos;
+    return temp1;
+}
+
+
+// Winning tile for a board size: TileValue on 4x4, doubling for each extra square per side
+int winningTile( int squaresPerSide)
+{
+    int Tile = TileValue;
+    for( int r=4; r<squaresPerSide; r++) {
+        Tile = Tile * 2;
+    }
+    return Tile;
+}
+
+bool placeableTile( int value)
+{
+    return value == 0 || (value >= 2 && value <= MaxPlaceableTile && (value & (value - 1)) == 0);
+}
+
+//--------------------------------------------------------------------
+
+void BoardSet(
+              int play[],           
+              int &blocks,   
+              int &Tile,
+              GameRng &rng)
+{
+    //  Initialization the array of int values used to represent the Ascii board
+   
+    for( int t =0; t <blocks; t++) {
+        for( int y =0; y <blocks; y++ ) {
+            play[ t*blocks + y] = 0;
+        }
+    }
+    
+    // Displaying and Calculatinng game value
+    Tile = winningTile( blocks);
+    std::cout << "Game ends when you reach ";
+    std::cout << Tile << ".";
+    std::cout <<std::endl;
+    
+    // To Set two random pieces for starting the game
+    Random1( play, blocks, rng);
+    Random1( play, blocks, rng);
+}
+
+
+
+void BoardVisual( int play[], int block, int score)
+{
+    std::cout << "\n";
+    std::cout << "Score: ";
+    std::cout << score <<std::endl;
+    for( int x =0; x <block; x++) {
+        std::cout << "   ";
+        for( int y=0; y<block; y++ ) {    // to display the board on the screen
+            int temp1 = x*block + y;  
+            std::cout << std::setw( 6);    
+            
+            if( play[ temp1] == 0) {
+                std::cout << '.';
+            }
+            else {
+                std::cout << play[ temp1];
+            }
+        }
+        std::cout << "\n\n";
+    }
+}
+
+
+// To Make a board copy .Used after an attempted move
+// to see if the board actually changed.
+void duplicate(
+               int BoardOld[], 
+               int play[],         
+               int blocks)       
+{
+    for( int g =0; g <blocks; g++) {
+        for( int h=0; h<blocks; h++ ) {
+            int temp2 = g*blocks + h;  
+            BoardOld[ temp2] = play[ temp2];
+        }
+    }
+}
+
+
+// Returning true if boards are different or false.
+bool Board1( int BoardOld[], int play[], int squaresPerSide)
+{
+    // To Compare the element by element.  If one is found that is different
+    // then return true, as board was changed.
+    for( int x =0; x <squaresPerSide; x++) {
+        for( int c=0; c<squaresPerSide; c++ ) {
+            int change = x*squaresPerSide + c;  
+            if( BoardOld[ change] != play[ change]) {
+                return true;
+            }
+        }
+    }
+    
+    return false;  
+}
+
+
+
+void slideRight( int play[], int blocks, int &score)
+{
+    
+    for( int e=0; e<blocks; e++) {
+       
+        int limit = e * blocks + blocks - 1;
+        
+        
+        for( int col=blocks - 1; col>=0; col--) {
+            
+            // get 1-d array index based on row and col
+            int current = e * blocks + col;
+            
+            // slide current piece over as far right as possible
+            while( current < limit && play[ current+1] == 0) {
+                play[ current+1] = play[ current];
+                play[ current] = 0;
+                current++;
+            }
+            
+           
+            if( (current < limit) && (play[ current+1] == play[ current]) && (play[ current] != 0) ) {
+                play[ current+1] = play[ current+1] + play[ current];
+                play[ current] = 0;
+                limit = current;           // Reset row index limit, to prevent combining a piece more than once
+                score += play[ current+1];  // Update score
+            }
+            
+        }//end for( int col...
+    }//end for( int row...
+    
+}//end slideRight()
+
+
+//--------------------------------------------------------------------
+// Slide all tiles up, combining matching values, updating the score
+void Up1( int board[], int squaresPerSide, int &score)
+{
+    // handle each column separately
+    for( int col=0; col<squaresPerSide; col++) {
+        // set index limit for this column to be index of top-most tile on this row
+        int limit = col;
+        
+        
+        for( int row=1; row<squaresPerSide; row++) {
+            
+            
+            int current = row * squaresPerSide + col;
+            
+           
+            while( (current > limit) && (board[ current-squaresPerSide] == 0) ) {
+                board[ current-squaresPerSide] = board[ current];
+                board[ current] = 0;
+                current = current - squaresPerSide;
+            }
+            
+            
+            if( (current > limit) && (board[ current-squaresPerSide] == board[ current]) && (board[ current] != 0) ) {
+                board[ current-squaresPerSide] = board[ current-squaresPerSide] + board[ current];
+                board[ current] = 0;
+                limit = current;           // Reset row index limit, to prevent combining a piece more than once
+                score += board[ current-squaresPerSide];  // Update score
+            }
+            
+        }//end for( int col...
+    }//end for( int row...
+    
+}//end slideUp()
+
+//--------------------------------------------------------------------
+// Slide all tiles down, combining matching values, updating the score
+void Down1( int play[], int squaresPerSide, int &score)
+{
+    // handle each column separately
+    for( int col=0; col<squaresPerSide; col++) {
+        // set index limit for this column to be index of bottom-most tile on this row
+        int limit = (squaresPerSide - 1) * squaresPerSide + col;
+        
+        // Start from the next to last row and process each element from bottom to top
+        for( int row=squaresPerSide-1; row>=0; row--) {
+            
+            // get 1-d array index based on row and col
+            int current = row * squaresPerSide + col;
+            
+            // slide current piece down as far as possible
+            while( current < limit && play[ current+squaresPerSide] == 0 ) {
+                play[ current+squaresPerSide] = play[ current];
+                play[ current] = 0;
+                current = current + squaresPerSide;
+            }
+            
+            // Combine it with lower neighbor if values are the same and non zero.
+            // The additional check for (current < limit) ensures a tile can be combined
+            // at most once on a move, since limit is moved up every time a combination is made.
+            if( (current < limit) && (play[ current+squaresPerSide] == play[ current]) && (play[ current] != 0) ) {
+                play[ current+squaresPerSide] = play[ current+squaresPerSide] + play[ current];
+                play[ current] = 0;
+                limit = current;           // Reset row index limit, to prevent combining a piece more than once
+                score += play[ current+squaresPerSide];  // Update score
+            }
+            
+        }//end for( int col...
+    }//end for( int row...
+    
+}//end slideDown()
+void Left1( int game[], int shapes, int &score)
+{
+    // handle each row separately
+    for( int s=0; s<shapes; s++) {
+        // set index limit for this row to be index of left-most tile on this row
+        int limit = s * shapes;
+        
+        // Start from the second column and process each element from left to right
+        for( int r=1; r<shapes; r++) {
+            
+            // get 1-d array index based on row and col
+            int current = s * shapes + r;
+            
+            // slide current piece over as far left as possible
+            while( current > limit && game[ current-1] == 0) {
+                game[ current-1] = game[ current];
+                game[ current] = 0;
+                current--;
+            }
+            
+            // Combine it with left neighbor if values are the same and non zero.
+            // The additional check for (current > limit) ensures a tile can be combined
+            // at most once on a move, since limit is moved right every time a combination is made.
+            // This ensures a row of:  2 2 4 4   ends up correctly as:  4 8 0 0   and not:  8 4 0 0
+            if( (current > limit) && (game[ current-1] == game[ current]) && (game[ current] != 0) ) {
+                game[ current-1] = game[ current-1] + game[ current];
+                game[ current] = 0;
+                limit = current;           // Reset row index limit, to prevent combining a piece more than once
+                score += game[ current-1];  // Update score
+            }
+            
+        }//end for( int col...
+    }//end for( int row...
+    
+}//end slideLeft()
+
+
+
+
+bool gameEnds( int play[],      // current play
+              int blocks,    // size of one side of board
+              int Tile) // max tile value for this size board
+{
+    // See if the Tile2, or a larger tile placed by hand, is found anywhere on the board.
+    // If so, game is over.
+    for( int d =0; d <blocks*blocks; d ++) {
+        if( play[ d] >= Tile) {
+            std::cout << "Congratulations!  You made it to ";
+            std::cout << Tile << " !!!" <<std::endl;
+            return true;  // game is over
+        }
+    }
+    
+    // See if there are any open squares.  If so return true since we aren't done
+    for( int d=0; d<blocks*blocks; d++) {
+        if( play[ d] == 0) {
+            return false;  // there are open squares, so game is not over
+        }
+    }
+    
+    // All squares are full.
+    // A move in any of the four directions is possible exactly when two
+    // neighbouring squares, across or down, hold the same value.
+    for( int i=0; i<blocks*blocks; i++) {
+        if( (i % blocks < blocks - 1) && (play[ i] == play[ i+1]) ) {
+            return false;  // Game is not over
+        }
+        if( (i < (blocks - 1) * blocks) && (play[ i] == play[ i+blocks]) ) {
+            return false;  // Game is not over
+        }
+    }
+    
+    std::cout << "\n";
+    std::cout << "No more available moves.  ";
+    std::cout << "Game is over.\n";
+    std::cout << "\n";
+    return true;  // Game is over since all squares are full and there are no moves
+}//end gameEnds()
@@ -0,0 +1,47 @@
+//
+// Game engine for 1024, shared by the graphical client and the other tools.
+//
+#ifndef GAME_H
+#define GAME_H
+
+#include "rng.h"
+
+const int MaxBoardSize = 12;  // Max number of squares per side
+const int TileValue = 1024;   // Max tile value to start out on a 4x4 board
+const int MaxPlaceableTile = 1 << 30;   // largest tile the p key may place
+
+
+// Place a 2 or 4 in a randomly chosen empty square, drawing from the game's generator.
+// Returns the square used, or -1 if the board was full.
+int Random1( int game[], int shapes, GameRng &rng);
+
+// Winning tile value for a board size
+int winningTile( int squaresPerSide);
+
+// True for a value the p key may place on a square: 0 to empty it, or a power of two
+// from 2 to MaxPlaceableTile.  The undo history and game records keep tiles as exponents, so any
+// other value would come back changed.
+bool placeableTile( int value);
+
+// Clear the board, compute the winning tile value and place the two starting pieces
+void BoardSet( int play[], int &blocks, int &Tile, GameRng &rng);
+
+// Display the board and score as text
+void BoardVisual( int play[], int block, int score);
+
+// Copy one board into another
+void duplicate( int BoardOld[], int play[], int blocks);
+
+// Returning true if boards are different or false.
+bool Board1( int BoardOld[], int play[], int squaresPerSide);
+
+// Slide all tiles in one direction, combining matching values, updating the score
+void slideRight( int play[], int blocks, int &score);
+void Left1( int game[], int shapes, int &score);
+void Up1( int board[], int squaresPerSide, int &score);
+void Down1( int play[], int squaresPerSide, int &score);
+
+// Returns true when the winning tile, or one larger, is on the board or no move is possible
+bool gameEnds( int play[], int blocks, int Tile);
+
+#endif
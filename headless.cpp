@@ -0,0 +1,197 @@
+//
+// Headless batch runner for 1024.
+//
+// Plays many complete games with a move policy across all cores, without opening a
+// window or waiting for input, then reports games/sec, moves/sec and the score and
+// max tile distributions.  Used for regression and capacity testing.  The games can
+// be saved to a binary record file and replayed from it later.
+//
+// To build and run:
+//    cmake -S . -B build && cmake --build build --target headless
+// or
+//    g++ -O2 -pthread headless.cpp simulate.cpp policy.cpp threadpool.cpp game.cpp
+//        boardkernels.cpp simdrows.cpp bitboard.cpp boardkey.cpp expectimax.cpp history.cpp
+//        record.cpp montecarlo.cpp positioncache.cpp ntuple.cpp -o headless
+//    ./headless --games 10000 --size 4 --policy corner --record games.rec
+//    ./headless --replay games.rec
+//    ./headless --games 100 --policy expectimax --cache openings.cache
+//    ./headless --train 100000 --weights ntuple.weights
+//    ./headless --games 1000 --policy ntuple --weights ntuple.weights
+//
+#include <iostream>          // For cout, endl
+#include <cstdlib>           // For atoi(), atol(), atof(), strtoul()
+#include <cstring>           // For strcmp()
+#include "game.h"
+#include "simulate.h"
+#include "record.h"
+#include "montecarlo.h"
+#include "positioncache.h"
+#include "ntuple.h"
+using namespace std;
+
+
+void displayUsage()
+{
+    cout << "Usage: headless [options]\n"
+         << "  --games N      number of games to play (default 1000)\n"
+         << "  --size N       squares per side, 4 to " << MaxBoardSize << " (default 4)\n"
+         << "  --policy NAME  move policy: " << policyNames() << " (default corner)\n"
+         << "  --budget MS    time per move for montecarlo (default " << DefaultRolloutMs << ")\n"
+         << "  --threads N    worker threads, 0 for one per core (default 0)\n"
+         << "  --seed N       seed for the games (default 1)\n"
+         << "  --record FILE  save every game to a record file\n"
+         << "  --replay FILE  replay and check the games in a record file, instead of playing\n"
+         << "  --cache FILE   answer opening positions from a cache file, adding the new ones;\n"
+         << "                 not for random or montecarlo, which draw on chance\n"
+         << "  --train GAMES  train the ntuple policy's weights by playing 4x4 games, instead of playing\n"
+         << "  --weights FILE weights for the ntuple policy (default " << DefaultWeightsFile << ")\n"
+         << "  --rate R       learning rate for --train (default " << DefaultLearningRate << ")\n";
+}
+
+
+int main( int argc, char *argv[])
+{
+    BatchOptions options;
+    options.games = 1000;
+    options.threads = 0;
+    options.squaresPerSide = 4;
+    options.policy = "corner";
+    options.moveBudgetMs = 0;
+    options.seed = 1;
+    options.pRecords = NULL;
+    options.pCache = NULL;
+    const char *recordPath = NULL;
+    const char *replayPath = NULL;
+    const char *cachePath = NULL;
+    const char *weightsPath = NULL;
+    long trainGames = 0;
+    float learningRate = DefaultLearningRate;
+
+    for( int i=1; i<argc; i++) {
+        if( i + 1 >= argc) {
+            displayUsage();
+            return 1;
+        }
+        if( strcmp( argv[ i], "--games") == 0) {
+            options.games = atoi( argv[ ++i]);
+        }
+        else if( strcmp( argv[ i], "--size") == 0) {
+            options.squaresPerSide = atoi( argv[ ++i]);
+        }
+        else if( strcmp( argv[ i], "--policy") == 0) {
+            options.policy = argv[ ++i];
+        }
+        else if( strcmp( argv[ i], "--budget") == 0) {
+            options.moveBudgetMs = atof( argv[ ++i]);
+        }
+        else if( strcmp( argv[ i], "--threads") == 0) {
+            options.threads = atoi( argv[ ++i]);
+        }
+        else if( strcmp( argv[ i], "--seed") == 0) {
+            options.seed = strtoul( argv[ ++i], NULL, 10);
+        }
+        else if( strcmp( argv[ i], "--record") == 0) {
+            recordPath = argv[ ++i];
+        }
+        else if( strcmp( argv[ i], "--replay") == 0) {
+            replayPath = argv[ ++i];
+        }
+        else if( strcmp( argv[ i], "--cache") == 0) {
+            cachePath = argv[ ++i];
+        }
+        else if( strcmp( argv[ i], "--train") == 0) {
+            trainGames = atol( argv[ ++i]);
+        }
+        else if( strcmp( argv[ i], "--weights") == 0) {
+            weightsPath = argv[ ++i];
+        }
+        else if( strcmp( argv[ i], "--rate") == 0) {
+            learningRate = atof( argv[ ++i]);
+        }
+        else {
+            displayUsage();
+            return 1;
+        }
+    }
+    if( replayPath != NULL) {
+        ReplayStats stats;
+        bool ok = replayRecords( replayPath, stats, cout);
+        cout << "Replayed " << stats.games << " games, " << stats.moves << " moves in "
+             << stats.seconds << " s (" << (long)(stats.moves / (stats.seconds > 0 ? stats.seconds : 1))
+             << " moves/sec)" << endl;
+        if( ok) {
+            cout << "Every game matches its record." << endl;
+        }
+        return ok ? 0 : 1;
+    }
+    if( trainGames > 0) {
+        const char *path = (weightsPath != NULL) ? weightsPath : DefaultWeightsFile;
+        NTupleNetwork network;
+        if( !network.open( path, true)) {
+            cout << "Unable to open " << path << " as n-tuple weights." << endl;
+            return 1;
+        }
+        TrainOptions train;
+        train.games = trainGames;
+        train.threads = options.threads;
+        train.learningRate = learningRate;
+        train.seed = options.seed;
+        train.reportEvery = 1000;
+        trainNetwork( network, train, cout);
+        cout << network.gamesTrained() << " games trained in " << path << endl;
+        return 0;
+    }
+    if( options.squaresPerSide < 4 || options.squaresPerSide > MaxBoardSize) {
+        cout << "Board size must be between 4 and " << MaxBoardSize << "." << endl;
+        return 1;
+    }
+
+    RecordWriter records;
+    if( recordPath != NULL) {
+        if( !records.open( recordPath)) {
+            cout << "Unable to create " << recordPath << "." << endl;
+            return 1;
+        }
+        options.pRecords = &records;
+    }
+
+    if( weightsPath != NULL) {
+        setPolicyWeights( weightsPath);
+    }
+
+    PositionCache cache;
+    if( cachePath != NULL) {
+        if( !policyIsDeterministic( options.policy)) {
+            cout << "The " << options.policy << " policy draws on chance, so its moves cannot be cached." << endl;
+            return 1;
+        }
+        uint64_t weights = (options.policy == "ntuple") ? policyNetwork().identity() : 0;
+        if( !cache.open( cachePath, options.policy, options.moveBudgetMs, weights)) {
+            cout << "Unable to open " << cachePath << " as a cache for the " << options.policy << " policy"
+                 << " with these settings." << endl;
+            return 1;
+        }
+        options.pCache = &cache;
+    }
+
+    BatchResult result;
+    if( !runBatch( options, result)) {
+        cout << "Unknown policy '" << options.policy << "'.  Choose one of: " << policyNames() << endl;
+        return 1;
+    }
+    cout << options.squaresPerSide << "x" << options.squaresPerSide << " board, "
+         << options.policy << " policy, seed " << options.seed << "\n";
+    reportBatch( result, cout);
+    if( recordPath != NULL) {
+        if( !records.close()) {
+            cout << "Unable to write every game to " << recordPath << "." << endl;
+            return 1;
+        }
+        cout << "Recorded " << records.games() << " games in " << recordPath << endl;
+    }
+    if( cachePath != NULL) {
+        cout << "Cache: " << cache.hits() << " hits in " << cache.lookups() << " lookups, "
+             << cache.entries() << " of " << cache.slots() << " slots used in " << cachePath << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,125 @@
+//
+// Background move hints.  See hint.h.
+//
+#include "hint.h"
+#include <chrono>            // For steady_clock
+#include "expectimax.h"
+
+
+const int HintMaxDepth = 8;              // moves looked ahead at most
+const long HintNodeBudget = 2000000;     // no deeper search is started once one depth takes this many nodes
+
+
+HintService::HintService()
+    : squaresPerSide( 0), generation( 0), pending( false), stopping( false), cancelled( false)
+{
+    worker = std::thread( &HintService::workerLoop, this);
+}
+
+
+HintService::~HintService()
+{
+    {
+        std::lock_guard<std::mutex> guard( lock);
+        stopping = true;
+        cancelled.store( true, std::memory_order_relaxed);
+    }
+    wakeUp.notify_one();
+    worker.join();
+}
+
+
+void HintService::start( const int board[], int squaresPerSide)
+{
+    {
+        std::lock_guard<std::mutex> guard( lock);
+        for( int i=0; i<squaresPerSide * squaresPerSide; i++) {
+            this->board[ i] = board[ i];
+        }
+        this->squaresPerSide = squaresPerSide;
+        generation++;
+        pending = true;
+        cancelled.store( true, std::memory_order_relaxed);
+    }
+    wakeUp.notify_one();
+}
+
+
+void HintService::cancel()
+{
+    std::lock_guard<std::mutex> guard( lock);
+    generation++;
+    pending = false;
+    cancelled.store( true, std::memory_order_relaxed);
+}
+
+
+bool HintService::poll( Hint &hint)
+{
+    // Later hints are deeper, so only the last one for the current board is kept
+    bool found = false;
+    Hint next;
+    while( results.pop( next)) {
+        if( next.generation == generation) {
+            hint = next;
+            found = true;
+        }
+    }
+    return found;
+}
+
+
+void HintService::workerLoop()
+{
+    int play[ MaxBoardSize * MaxBoardSize];
+    for( ;;) {
+        int size;
+        unsigned job;
+        {
+            std::unique_lock<std::mutex> guard( lock);
+            wakeUp.wait( guard, [this]() { return pending || stopping; });
+            if( stopping) {
+                return;
+            }
+            size = squaresPerSide;
+            for( int i=0; i<size * size; i++) {
+                play[ i] = board[ i];
+            }
+            job = generation;
+            pending = false;
+            cancelled.store( false, std::memory_order_relaxed);   // under the lock, so no later cancel is lost
+        }
+        deepen( play, size, job);
+    }
+}
+
+
+// Search one depth after another, sending each one's best move, until the search is
+// cancelled, reaches HintMaxDepth or the last depth grew too large to go deeper.  A depth
+// that searched no more nodes than the one before was cut off everywhere by the chance
+// of reaching its positions, so going deeper would only search the same nodes again.
+void HintService::deepen( const int board[], int squaresPerSide, unsigned job)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    long lastNodes = 0;
+    for( int depth=1; depth<=HintMaxDepth; depth++) {
+        float value;
+        SearchStats stats;
+        char direction = searchBestMove( board, squaresPerSide, depth, &cancelled, value, stats);
+        if( direction == 0) {
+            return;   // cancelled, or there is no move to hint
+        }
+        Hint hint;
+        hint.generation = job;
+        hint.direction = direction;
+        hint.depth = depth;
+        hint.value = value;
+        hint.nodes = stats.nodes;
+        hint.seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start).count();
+        results.push( hint);   // dropped only if poll() has not been called for several boards
+        if( stats.nodes > HintNodeBudget || stats.nodes <= lastNodes) {
+            return;
+        }
+        lastNodes = stats.nodes;
+    }
+}
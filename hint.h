@@ -0,0 +1,70 @@
+//
+// Background move hints.
+//
+// The hint service searches the board it is given with expectimax on a thread of its
+// own, one depth at a time (iterative deepening), so the caller's loop carries on
+// drawing frames and reading keys while it works.  Each finished depth sends its best
+// move back through a lock-free single-producer single-consumer queue, which the caller
+// drains with poll() as often as it likes without waiting.  Starting a new board or
+// cancelling stops the search in flight within a few hundred nodes, and any hints
+// still queued for the old board are dropped.
+//
+#ifndef HINT_H
+#define HINT_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "game.h"
+#include "spscqueue.h"
+
+
+struct Hint
+{
+    unsigned generation;   // the start() this hint answers
+    char direction;        // w, a, s or d
+    int depth;             // moves looked ahead
+    float value;
+    long nodes;            // positions searched for this depth
+    double seconds;        // time since start()
+};
+
+
+class HintService
+{
+public:
+    HintService();
+    ~HintService();
+
+    // Stop any search in flight and start deepening on a copy of board
+    void start( const int board[], int squaresPerSide);
+
+    // Stop any search in flight, without starting another
+    void cancel();
+
+    // Take the deepest hint found for the board last started since the previous call.
+    // Returns false if there is none.  Never waits.
+    bool poll( Hint &hint);
+
+private:
+    void workerLoop();
+    void deepen( const int board[], int squaresPerSide, unsigned job);
+
+    std::mutex lock;                    // guards the request below, held only to copy it
+    std::condition_variable wakeUp;     // signalled when a request arrives or on stopping
+    int board[ MaxBoardSize * MaxBoardSize];
+    int squaresPerSide;
+    unsigned generation;                // counts start() and cancel() calls
+    bool pending;                       // board is waiting to be searched
+    bool stopping;
+
+    std::atomic<bool> cancelled;        // read by the search every few hundred nodes
+    SpscQueue<Hint, 64> results;        // written by the worker, read by poll()
+    std::thread worker;
+
+    HintService( const HintService &);              // not copyable
+    HintService &operator=( const HintService &);
+};
+
+#endif
@@ -0,0 +1,212 @@
+//
+// Undo and redo history for 1024.  See history.h.
+//
+#include "history.h"
+#include <iostream>          // For cout, endl
+#include "boardkernels.h"
+
+
+// Tile values are powers of two (placeableTile keeps the p key to them), so one byte
+// holds any of them as an exponent
+static unsigned char exponentOf( int value)
+{
+    return (value == 0) ? 0 : (unsigned char)__builtin_ctz( value);
+}
+
+
+UndoHistory::UndoHistory( int depth)
+    : limit( depth < 0 ? 0 : depth), cells( 0), current( -1), firstStep( 0)
+{
+}
+
+
+void UndoHistory::reset( int squaresPerSide)
+{
+    cells = squaresPerSide * squaresPerSide;
+    current = -1;
+    // swap with empty vectors, so the memory of a long game is given back
+    std::vector<Entry>().swap( entries);
+    std::vector<unsigned char>().swap( deltas);
+}
+
+
+void UndoHistory::push( const int board[], int score, int step)
+{
+    // Forget the moves that were undone
+    if( redoSize() > 0) {
+        deltas.resize( deltaEnd( current));
+        entries.resize( current + 1);
+    }
+    if( current < 0) {
+        firstStep = step;
+    }
+
+    Entry entry;
+    entry.deltaStart = deltas.size();
+    entry.score = score;
+    for( int i=0; i<cells; i++) {
+        unsigned char exponent = exponentOf( board[ i]);
+        if( current >= 0 && exponent != now[ i]) {
+            deltas.push_back( (unsigned char)i);
+            deltas.push_back( now[ i]);
+            deltas.push_back( exponent);
+        }
+        now[ i] = exponent;
+    }
+    entries.push_back( entry);
+    current++;
+
+    if( limit > 0 && (int)entries.size() > limit + DropBlock) {
+        dropOldest();
+    }
+}
+
+
+bool UndoHistory::pop( int board[], int &score, int &step)
+{
+    if( current <= 0) {
+        return false;
+    }
+    for( int i=deltaEnd( current) - 3; i>=(int)entries[ current].deltaStart; i-=3) {
+        now[ deltas[ i]] = deltas[ i+1];
+    }
+    current--;
+    output( board);
+    score = entries[ current].score;
+    step = firstStep + current;
+    return true;
+}
+
+
+bool UndoHistory::redo( int board[], int &score, int &step)
+{
+    if( redoSize() == 0) {
+        return false;
+    }
+    current++;
+    for( int i=entries[ current].deltaStart; i<deltaEnd( current); i+=3) {
+        now[ deltas[ i]] = deltas[ i+2];
+    }
+    output( board);
+    score = entries[ current].score;
+    step = firstStep + current;
+    return true;
+}
+
+
+long UndoHistory::bytes() const
+{
+    return (long)(entries.capacity() * sizeof( Entry) + deltas.capacity());
+}
+
+
+// Offset just past the changes made by one move
+int UndoHistory::deltaEnd( int entry) const
+{
+    return (entry + 1 < (int)entries.size()) ? entries[ entry+1].deltaStart : deltas.size();
+}
+
+
+// Drop the oldest DropBlock moves.  The board after them becomes the oldest one kept,
+// which nothing can be undone past, so its own changes are no longer needed either.
+void UndoHistory::dropOldest()
+{
+    uint32_t dropped = deltaEnd( DropBlock);
+    deltas.erase( deltas.begin(), deltas.begin() + dropped);
+    entries.erase( entries.begin(), entries.begin() + DropBlock);
+    entries[ 0].deltaStart = 0;
+    for( int i=1; i<(int)entries.size(); i++) {
+        entries[ i].deltaStart -= dropped;
+    }
+    current -= DropBlock;
+    firstStep += DropBlock;
+}
+
+
+// Write the board being shown back out as tile values
+void UndoHistory::output( int board[]) const
+{
+    for( int i=0; i<cells; i++) {
+        board[ i] = (now[ i] == 0) ? 0 : (1 << now[ i]);
+    }
+}
+
+
+//--------------------------------------------------------------------
+static bool reportMismatch( const char *what, int play[], int squaresPerSide, int step)
+{
+    std::cout << "Undo history mismatch on " << squaresPerSide << "x" << squaresPerSide
+              << " board, " << what << " at move " << step << std::endl;
+    BoardVisual( play, squaresPerSide, 0);
+    return false;
+}
+
+
+bool historyMatchesReference( int moves, unsigned seed)
+{
+    const char directions[] = { 'w', 'a', 's', 'd' };
+    // Values the p key might be given; only the powers of two may reach the history
+    const int placed[] = { 1, 3, 6, 2, 1024, 1 << 30, 0 };
+    GameRng rng( seed);
+
+    for( int squaresPerSide=4; squaresPerSide<=MaxBoardSize; squaresPerSide++) {
+        const BoardKernels &kernels = boardKernels( squaresPerSide);
+        int cells = squaresPerSide * squaresPerSide;
+        std::vector<int> boards;   // full copy of every board, cells values each
+        std::vector<int> scores;
+        int play[ MaxBoardSize * MaxBoardSize] = { 0 };
+        int score = 0;
+        int step = 1;
+        Random1( play, squaresPerSide, rng);
+        Random1( play, squaresPerSide, rng);
+        UndoHistory history;
+        history.reset( squaresPerSide);
+        history.push( play, score, step);
+        boards.insert( boards.end(), play, play + cells);
+        scores.push_back( score);
+
+        for( int m=0; m<moves; m++) {
+            int value = placed[ rng.below( sizeof( placed) / sizeof( placed[ 0]))];
+            if( rng.below( 8) == 0 && placeableTile( value)) {
+                // A placement is kept as a move of its own here, so it can be undone
+                play[ rng.below( cells)] = value;
+            }
+            else if( !applyMove( kernels, play, directions[ rng.below( 4)], score).changed) {
+                continue;
+            }
+            else if( Random1( play, squaresPerSide, rng) < 0) {
+                break;
+            }
+            step++;
+            history.push( play, score, step);
+            boards.insert( boards.end(), play, play + cells);
+            scores.push_back( score);
+        }
+
+        // Back to the first board, then forward again to the last
+        for( int s=step-1; s>=1; s--) {
+            if( !history.pop( play, score, step) || step != s) {
+                return reportMismatch( "undo count", play, squaresPerSide, s);
+            }
+            if( Board1( &boards[ (s - 1) * cells], play, squaresPerSide) || score != scores[ s - 1]) {
+                return reportMismatch( "undone board", play, squaresPerSide, s);
+            }
+        }
+        for( int s=2; s<=(int)scores.size(); s++) {
+            if( !history.redo( play, score, step) || step != s) {
+                return reportMismatch( "redo count", play, squaresPerSide, s);
+            }
+            if( Board1( &boards[ (s - 1) * cells], play, squaresPerSide) || score != scores[ s - 1]) {
+                return reportMismatch( "redone board", play, squaresPerSide, s);
+            }
+        }
+    }
+
+    // Values that one byte's exponent cannot give back must never be placed
+    if( placeableTile( 1) || placeableTile( 3) || placeableTile( 6) || placeableTile( -2)
+        || !placeableTile( 0) || !placeableTile( 2) || !placeableTile( 1 << 30)) {
+        std::cout << "Undo history mismatch: placeableTile accepts a value the history cannot keep" << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,73 @@
+//
+// Undo and redo history for 1024.
+//
+// Instead of a copy of the board per move, each move is kept as the list of squares
+// it changed (square index, old and new tile exponent, one byte each) plus the score
+// after it, so a typical move costs a few dozen bytes even on a 12x12 board.  Moves
+// are numbered one after another from the first board kept.  The board being shown is
+// kept unpacked, and undo and redo apply one move's changes to it backward or forward,
+// so they touch only the squares that changed no matter how long the game is.  With a
+// depth limit, the oldest moves are dropped DropBlock at a time.
+//
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdint.h>
+#include <vector>
+#include "game.h"
+
+const int DefaultHistoryDepth = 0;     // moves kept for undo, 0 for no limit
+const int DropBlock = 256;             // oldest moves dropped at once when over the limit
+
+
+class UndoHistory
+{
+public:
+    // Keep at least depth moves for undo, or every move if depth is 0
+    explicit UndoHistory( int depth = DefaultHistoryDepth);
+
+    // Free all moves and start over with a board of the given size
+    void reset( int squaresPerSide);
+
+    // Save the board after a move, whose number must be one more than the board before.
+    // Any moves that were undone can no longer be redone.
+    void push( const int board[], int score, int step);
+
+    // Go back one move, or forward again over a move that was undone.
+    // Each returns false, changing nothing, if there is no such move.
+    bool pop( int board[], int &score, int &step);
+    bool redo( int board[], int &score, int &step);
+
+    int size() const { return current + 1; }           // boards reachable by undo, including this one
+    int redoSize() const { return (int)entries.size() - 1 - current; }
+    int depth() const { return limit; }
+    int oldestStep() const { return firstStep; }   // move number of the oldest board still kept
+    long bytes() const;           // memory held by the history
+
+private:
+    struct Entry
+    {
+        uint32_t deltaStart;      // offset of this move's changes in deltas, which end where the next move's start
+        int32_t score;            // score after the move
+    };
+
+    int limit;
+    int cells;                         // squares on the board
+    int current;                       // entry for the board being shown
+    int firstStep;                     // move number of entries[0]
+    unsigned char now[ MaxBoardSize * MaxBoardSize];   // exponents of the board being shown
+    std::vector<Entry> entries;        // entries[0] is the oldest board kept
+    std::vector<unsigned char> deltas; // index, old exponent, new exponent per changed square
+
+    int deltaEnd( int entry) const;
+    void dropOldest();
+    void output( int board[]) const;
+};
+
+
+// Play random moves and p-key placements on every board size, then undo back to the
+// start and redo to the end, checking each board against a full copy kept along the
+// way.  Prints any mismatch and returns false if one is found.
+bool historyMatchesReference( int moves, unsigned seed);
+
+#endif
@@ -0,0 +1,343 @@
+//
+// Load generator for the 1024 game server.
+//
+// Opens a number of connections to a running server, each on its own thread, and
+// starts its share of the sessions on every one, so that all the sessions are open at
+// once.  It then plays them in turn, one random move per session per round, addressing
+// each by its id, until each game ends or has had its moves, and ends each session
+// with x.  Every command waits for its reply, and the time between sending the line
+// and reading the reply is that command's latency.  At the end it reports sessions/sec,
+// commands/sec and the latency distribution.
+//
+// To build and run, with the server already running:
+//    cmake -S . -B build && cmake --build build --target loadgen
+// or
+//    g++ -O2 -pthread loadgen.cpp -o loadgen
+//    ./loadgen --port 10240 --connections 8 --sessions 2000 --moves 200
+//
+#include <iostream>          // For cout, endl
+#include <iomanip>           // used for setting output field size using setw
+#include <algorithm>         // For sort()
+#include <chrono>            // For steady_clock
+#include <cstdlib>           // For atoi(), strtoull()
+#include <cstring>           // For strcmp(), memset()
+#include <string>
+#include <thread>
+#include <vector>
+#include <errno.h>
+#include <unistd.h>          // For read(), write(), close()
+#include <arpa/inet.h>       // For inet_pton()
+#include <netinet/in.h>      // For sockaddr_in
+#include <netinet/tcp.h>     // For TCP_NODELAY
+#include <sys/socket.h>
+#include <sys/un.h>          // For sockaddr_un
+#include "rng.h"
+using namespace std;
+
+
+const int DefaultPort = 10240;
+const char Directions[] = { 'w', 'a', 's', 'd' };
+
+
+struct LoadOptions
+{
+    const char *host;
+    int port;
+    const char *path;      // Unix socket, instead of host and port
+    int connections;
+    int sessions;
+    int moves;             // most moves played in each session
+    int squaresPerSide;
+    uint64_t seed;
+};
+
+
+// What one connection did
+struct ConnectionResult
+{
+    bool connected;
+    long sessions;         // sessions started and ended
+    long commands;
+    long errors;           // replies starting with "error"
+    vector<float> latencies;   // microseconds, one per command
+};
+
+
+//--------------------------------------------------------------------
+// A blocking connection to the server that sends one line and reads back its reply
+class LineClient
+{
+public:
+    LineClient() : fd( -1), start( 0) {}
+    ~LineClient()
+    {
+        if( fd >= 0) {
+            close( fd);
+        }
+    }
+
+    bool connect( const LoadOptions &options)
+    {
+        if( options.path != NULL) {
+            sockaddr_un address;
+            memset( &address, 0, sizeof( address));
+            address.sun_family = AF_UNIX;
+            strncpy( address.sun_path, options.path, sizeof( address.sun_path) - 1);
+            fd = socket( AF_UNIX, SOCK_STREAM, 0);
+            return fd >= 0 && ::connect( fd, (sockaddr *)&address, sizeof( address)) == 0;
+        }
+        sockaddr_in address;
+        memset( &address, 0, sizeof( address));
+        address.sin_family = AF_INET;
+        address.sin_port = htons( options.port);
+        if( inet_pton( AF_INET, options.host, &address.sin_addr) != 1) {
+            return false;
+        }
+        fd = socket( AF_INET, SOCK_STREAM, 0);
+        int on = 1;
+        return fd >= 0 && setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof( on)) == 0
+               && ::connect( fd, (sockaddr *)&address, sizeof( address)) == 0;
+    }
+
+    // Send line and a newline, then wait for the reply, without its newline.  Returns
+    // false if the connection fails.
+    bool request( const string &line, string &reply)
+    {
+        string out = line + '\n';
+        for( size_t sent=0; sent<out.size(); ) {
+            ssize_t length = write( fd, out.data() + sent, out.size() - sent);
+            if( length < 0 && errno != EINTR) {
+                return false;
+            }
+            sent += (length > 0) ? length : 0;
+        }
+        for( ;;) {
+            size_t end = buffer.find( '\n', start);
+            if( end != string::npos) {
+                reply.assign( buffer, start, end - start);
+                start = end + 1;
+                if( start == buffer.size()) {
+                    buffer.clear();
+                    start = 0;
+                }
+                return true;
+            }
+            char chunk[ 4096];
+            ssize_t length = read( fd, chunk, sizeof( chunk));
+            if( length == 0 || (length < 0 && errno != EINTR)) {
+                return false;
+            }
+            if( length > 0) {
+                buffer.append( chunk, length);
+            }
+        }
+    }
+
+private:
+    int fd;
+    string buffer;     // bytes read but not yet returned
+    size_t start;      // where the next reply begins in buffer
+};
+
+
+// One of the connection's sessions, while it is being played
+struct PlayedSession
+{
+    uint64_t id;
+    int moves;
+    bool over;
+};
+
+
+// Time one command, counting it and any error
+static bool timedRequest( LineClient &client, const string &line, string &reply, ConnectionResult &result)
+{
+    chrono::steady_clock::time_point sent = chrono::steady_clock::now();
+    if( !client.request( line, reply)) {
+        return false;
+    }
+    result.latencies.push_back( chrono::duration<float, micro>( chrono::steady_clock::now() - sent).count());
+    result.commands++;
+    if( reply.compare( 0, 5, "error") == 0) {
+        result.errors++;
+    }
+    return true;
+}
+
+
+// Status word of a board reply: "ID MOVE SCORE STATUS tiles..."
+static string replyStatus( const string &reply)
+{
+    size_t p = 0;
+    for( int field=0; field<3 && p != string::npos; field++) {
+        p = reply.find( ' ', p);
+        p = (p != string::npos) ? p + 1 : p;
+    }
+    if( p == string::npos) {
+        return "";
+    }
+    return reply.substr( p, reply.find( ' ', p) - p);
+}
+
+
+// Start this connection's sessions, play them round by round, then end them
+void runConnection( const LoadOptions &options, int index, int sessions, ConnectionResult &result)
+{
+    result.connected = false;
+    result.sessions = 0;
+    result.commands = 0;
+    result.errors = 0;
+    LineClient client;
+    if( !client.connect( options)) {
+        return;
+    }
+    result.connected = true;
+    GameRng rng( options.seed, index);
+    string reply;
+    string newLine = "n " + to_string( options.squaresPerSide);
+
+    vector<PlayedSession> played;
+    for( int s=0; s<sessions; s++) {
+        if( !timedRequest( client, newLine, reply, result)) {
+            return;
+        }
+        PlayedSession session = { strtoull( reply.c_str(), NULL, 10), 0, false };
+        if( session.id != 0) {
+            played.push_back( session);
+        }
+    }
+
+    int remaining = (int)played.size();
+    while( remaining > 0) {
+        for( size_t s=0; s<played.size(); s++) {
+            PlayedSession &session = played[ s];
+            if( session.over) {
+                continue;
+            }
+            string line = to_string( session.id) + ' ' + Directions[ rng.below( 4)];
+            if( !timedRequest( client, line, reply, result)) {
+                return;
+            }
+            session.moves++;
+            if( replyStatus( reply) != "playing" || session.moves >= options.moves) {
+                if( !timedRequest( client, to_string( session.id) + " x", reply, result)) {
+                    return;
+                }
+                session.over = true;
+                remaining--;
+                result.sessions++;
+            }
+        }
+    }
+}
+
+
+//--------------------------------------------------------------------
+void displayUsage()
+{
+    cout << "Usage: loadgen [options]\n"
+         << "  --host ADDR        server's IPv4 address (default 127.0.0.1)\n"
+         << "  --port N           server's TCP port (default " << DefaultPort << ")\n"
+         << "  --unix PATH        connect to the server's Unix socket instead\n"
+         << "  --connections N    connections, each on its own thread (default 8)\n"
+         << "  --sessions N       sessions, shared out over the connections (default 2000)\n"
+         << "  --moves N          most moves in each session (default 200)\n"
+         << "  --size N           squares per side (default 4)\n"
+         << "  --seed N           seed for the moves (default 1)\n";
+}
+
+
+int main( int argc, char *argv[])
+{
+    LoadOptions options;
+    options.host = "127.0.0.1";
+    options.port = DefaultPort;
+    options.path = NULL;
+    options.connections = 8;
+    options.sessions = 2000;
+    options.moves = 200;
+    options.squaresPerSide = 4;
+    options.seed = 1;
+    for( int i=1; i<argc; i++) {
+        if( i + 1 >= argc) {
+            displayUsage();
+            return 1;
+        }
+        if( strcmp( argv[ i], "--host") == 0) {
+            options.host = argv[ ++i];
+        }
+        else if( strcmp( argv[ i], "--port") == 0) {
+            options.port = atoi( argv[ ++i]);
+        }
+        else if( strcmp( argv[ i], "--unix") == 0) {
+            options.path = argv[ ++i];
+        }
+        else if( strcmp( argv[ i], "--connections") == 0) {
+            options.connections = atoi( argv[ ++i]);
+        }
+        else if( strcmp( argv[ i], "--sessions") == 0) {
+            options.sessions = atoi( argv[ ++i]);
+        }
+        else if( strcmp( argv[ i], "--moves") == 0) {
+            options.moves = atoi( argv[ ++i]);
+        }
+        else if( strcmp( argv[ i], "--size") == 0) {
+            options.squaresPerSide = atoi( argv[ ++i]);
+        }
+        else if( strcmp( argv[ i], "--seed") == 0) {
+            options.seed = strtoull( argv[ ++i], NULL, 10);
+        }
+        else {
+            displayUsage();
+            return 1;
+        }
+    }
+    if( options.connections < 1 || options.sessions < 1 || options.moves < 1) {
+        displayUsage();
+        return 1;
+    }
+
+    vector<ConnectionResult> results( options.connections);
+    vector<thread> threads;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for( int c=0; c<options.connections; c++) {
+        int sessions = options.sessions / options.connections + (c < options.sessions % options.connections);
+        threads.push_back( thread( runConnection, cref( options), c, sessions, ref( results[ c])));
+    }
+    for( size_t t=0; t<threads.size(); t++) {
+        threads[ t].join();
+    }
+    double seconds = chrono::duration<double>( chrono::steady_clock::now() - start).count();
+
+    long sessions = 0;
+    long commands = 0;
+    long errors = 0;
+    int failed = 0;
+    vector<float> latencies;
+    for( size_t c=0; c<results.size(); c++) {
+        sessions += results[ c].sessions;
+        commands += results[ c].commands;
+        errors += results[ c].errors;
+        failed += !results[ c].connected;
+        latencies.insert( latencies.end(), results[ c].latencies.begin(), results[ c].latencies.end());
+    }
+    if( failed == options.connections) {
+        cout << "Unable to connect to the server." << endl;
+        return 1;
+    }
+    sort( latencies.begin(), latencies.end());
+
+    cout << fixed << setprecision( 1);
+    cout << sessions << " sessions, " << commands << " commands on " << options.connections - failed
+         << " connections in " << seconds << " s\n";
+    cout << "  sessions/sec: " << sessions / seconds << "\n";
+    cout << "  commands/sec: " << commands / seconds << "\n";
+    cout << "  errors: " << errors << "\n";
+    if( !latencies.empty()) {
+        size_t n = latencies.size();
+        cout << "Latency (us)\n"
+             << "  p50 " << latencies[ n / 2] << "  p90 " << latencies[ n * 9 / 10]
+             << "  p99 " << latencies[ n * 99 / 100] << "  max " << latencies[ n - 1] << endl;
+    }
+    return (errors == 0 && failed == 0 && sessions == options.sessions) ? 0 : 1;
+}
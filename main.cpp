@@ -10,6 +10,22 @@
 //         Failed to initialize inotify, joystick connections and disconnections won't be notified
 //    To see the graphical output then select the "Viewer" option at the top of the window.
 //
+// To build from the command line instead, cmake builds sfml-app along with the other
+// programs when SFML is installed, or:
+//    g++ -O2 -pthread main.cpp game.cpp bitboard.cpp boardkey.cpp boardkernels.cpp simdrows.cpp expectimax.cpp
+//        montecarlo.cpp ntuple.cpp hint.cpp policy.cpp threadpool.cpp history.cpp record.cpp renderer.cpp terminal.cpp
+//        profile.cpp -o sfml-app -lsfml-graphics -lsfml-window -lsfml-system
+// Adding -DNO_PROFILING leaves out the phase timers shown by the o key.
+// Running "./sfml-app --check" compares the bitboard move engine against the moves in game.cpp,
+// and the packed board keys and their symmetries against the boards they were made from.
+// Running "./sfml-app --seed N" replays the game that printed "Game seed: N".
+// Running "./sfml-app --history N" keeps only the last N moves or so for undo, instead of all of them.
+// Running "./sfml-app --record FILE" saves the games played to a record file, which
+// "./headless --replay FILE" plays back and checks.
+// Running "./sfml-app --ai NAME" has the e and E keys play with another policy from policy.h,
+// and "--weights FILE" gives the weights the ntuple policy plays with.
+// Running "./sfml-app --profile FILE" writes the phase timers and counters to a file every few seconds.
+//
 // For more information about SFML graphics, see: https://www.sfml-dev.org/tutorials
 // Be sure to close the old window each time you rebuild and rerun, to ensure you
 // are seeing the latest output.
@@ -21,143 +37,133 @@
 #include <SFML/Graphics.hpp> // Needed to access all the SFML graphics libraries
 #include <iostream>          // For cin, cout, endl
 #include <iomanip>           // used for setting output field size using setw
-#include <cstdlib>           // For rand()
+#include <cstdlib>           // For exit(), strtoull()
 #include <cstdio>            // For sprintf, "printing" to a string
 #include <cstring>           // For c-string functions such as strlen()
-#include <chrono>            // Used in pausing for some milliseconds using sleep_for(...)
-#include <thread>            // Used in pausing for some milliseconds using sleep_for(...)
+#include <cctype>            // For isspace(), isdigit()
+#include <algorithm>         // For max()
+#include <ctime>             // For clock(), to measure CPU use
+#include <chrono>            // For steady_clock, to measure input latency
+#include <random>            // For random_device, to pick a seed
+#include <string>
+#include "game.h"            // Board setup, moves and end-of-game check
+#include "history.h"         // Moves kept for undo and redo
+#include "record.h"          // Saving the games played to a file
+#include "renderer.h"        // Drawing the board, updating only the squares that changed
+#include "terminal.h"        // Reading moves typed in the terminal without blocking
+#include "bitboard.h"        // Packed exponent move engine, checked against game.h
+#include "boardkey.h"        // Packed board keys, checked against their boards
+#include "boardkernels.h"    // Move and end-of-game functions specialized for each board size
+#include "policy.h"          // Computer player for the e and E keys
+#include "expectimax.h"      // Search statistics of the default computer player
+#include "ntuple.h"          // Weights for the ntuple computer player
+#include "hint.h"            // Move hints searched in the background, for the h key
+#include "threadpool.h"      // Worker threads for the computer player
+#include "profile.h"         // Phase timers, for the o key overlay and --profile
 using namespace std;
 
 
 const int WindowYSize = 500;
-const int MaxBoardSize = 12;  // Max number of squares per side
-const int TileValue = 1024;   // Max tile value to start out on a 4x4 board
 const int WindowXSize = 400;
+const int MessageStripHeight = 40;   // pixels at the bottom of the window kept for the messages label
+const int FrameLimit = 60;      // frames per second at most, while the computer plays
+const int IdleWaitMs = 10;      // longest wait for terminal input before polling the window again
+const size_t MaxArgumentLength = 40;   // characters kept of the numbers typed after r or p
+const double ProfileLogSeconds = 5;   // time between reports written by --profile
+const int OverlayTextSize = 11;
 
 
-struct Node
+// How quickly input shows up on screen, and how busy the program is while it waits
+struct LoopStats
 {
-    int Dupboard[MaxBoardSize * MaxBoardSize];   // declaring all the required ints and variables
-    int score;
-    Node* pNext;
-    int step;
+    long inputs;
+    double latencySum;       // seconds from each input to the frame showing its result
+    double latencyMax;
+    std::chrono::steady_clock::time_point start;
 };
 
 
-//---------------------------------------------------------------------------------------
-class Square {
-public:
-    // Default Constructor
-    Square()
-    {
-        size = 0;
-        xPosition = 0;
-        yPosition = 0;
-        color = sf::Color::Black;
-        isVisible = false;
-        isCaptured = false;
-        text = "";
-    }
-    
-    // Fully-qualified constructor, used to set all fields
-    Square( int theSize, int theXPosition, int theYPosition,
-           const sf::Color &theColor, bool theVisibility, std::string theText)
-    {
-        // Set the class fields
-        size = theSize;
-        xPosition = theXPosition;
-        yPosition = theYPosition;
-        color = theColor;
-        isVisible = theVisibility;
-        isCaptured = false;   // By default squares have not been captured
-        text = theText;
-        // Use the values to set the display characteristics of theSquare
-        theSquare.setSize( sf::Vector2f(theSize, theSize));
-        theSquare.setPosition( theXPosition, theYPosition);   // Set the position of the square
-        theSquare.setFillColor( theColor);
-    }
-    
-    // Get (accessor) functions
-    sf::RectangleShape getTheSquare() { return theSquare; }
-    int getSize() { return size; }
-    int getXPosition() { return xPosition; }
-    int getYPosition() { return yPosition; }
-    sf::Color& getColor() { return color; }
-    bool getIsVisible() { return isVisible; }
-    bool getIsCaptured() { return isCaptured; }
-    std::string getText() { return text; }
-    
-    // Set (mutator) functions
-    void setSize( int theSize) {
-        size = theSize;
-        theSquare.setSize( sf::Vector2f(theSize, theSize));
-    }
-    void setXPosition( int theXPosition) {
-        xPosition = theXPosition;
-        theSquare.setPosition( theXPosition, yPosition);   // Set the position of the square
-    }
-    void setYPosition( int theYPosition) {
-        yPosition = theYPosition;
-        theSquare.setPosition( xPosition, theYPosition);   // Set the position of the square
+void reportLoopStats( const LoopStats &stats)
+{
+    double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - stats.start).count();
+    double cpuSeconds = (double)std::clock() / CLOCKS_PER_SEC;
+    std::cout << "Input to frame: " << stats.inputs << " inputs, mean "
+              << 1000 * stats.latencySum / (stats.inputs > 0 ? stats.inputs : 1) << " ms, max "
+              << 1000 * stats.latencyMax << " ms.  CPU: "
+              << 100 * cpuSeconds / (seconds > 0 ? seconds : 1) << "% of one core over "
+              << seconds << " s" << std::endl;
+}
+
+
+// Map a key pressed in the window to the command letter typed for it in the terminal,
+// or 0 if it is not a command
+char windowCommand( const sf::Event &event)
+{
+    if( event.type == sf::Event::TextEntered && event.text.unicode < 128
+        && !isspace( (int)event.text.unicode)) {
+        return (char)event.text.unicode;
     }
-    void setColor( sf::Color & theColor) {
-        color = theColor;
-        theSquare.setFillColor( theColor);    // Also update the color on the square itself
+    if( event.type == sf::Event::KeyPressed) {
+        switch( event.key.code) {
+            case sf::Keyboard::Up:    return 'w';
+            case sf::Keyboard::Left:  return 'a';
+            case sf::Keyboard::Down:  return 's';
+            case sf::Keyboard::Right: return 'd';
+            default:                  return 0;
+        }
     }
-    void setColor( int R, int G, int B) {
-        sf::Color theNewColor( R, G, B);
-        color = theNewColor;
-        theSquare.setFillColor( theNewColor);
+    return 0;
+}
+
+
+// The character typed in the window, spaces, Enter (as '\r'), Backspace and Escape
+// included, for the numbers after r and p, or 0 if no character was typed
+char windowCharacter( const sf::Event &event)
+{
+    if( event.type == sf::Event::TextEntered && event.text.unicode < 128) {
+        return (char)event.text.unicode;
     }
-    void setVisibility( bool theVisibility) { isVisible = theVisibility; }
-    void setIsCaptured( bool isCaptured) { this->isCaptured = isCaptured; }
-    void setText( std::string theText) { text = theText; }
-    
-    // Utility functions
-    void displayText( sf::RenderWindow *pWindow, sf::Font theFont, sf::Color theColor, int textSize);
-    
-private:
-    int size;
-    int xPosition;
-    int yPosition;
-    sf::Color color;
-    bool isVisible;
-    bool isCaptured;   // Indicates whether or not it is part of the captured area
-    std::string text;
-    sf::RectangleShape theSquare;
-    
-}; //end class Square
+    return 0;
+}
 
 
-void Square::displayText(
-                         sf::RenderWindow *pWindow,   // The window into which we draw everything
-                         sf::Font theFont,            // Font to be used in displaying text
-                         sf::Color theColor,          // Color of the font
-                         int textSize)                // Size of the text to be displayed
+// Read the numbers typed so far after r or p.  Returns 1 once count numbers have been
+// typed, each ended by a space or Enter, 0 while more are to come, or -1 if something
+// other than a number was typed.
+int readArguments( const std::string &text, int count, int values[])
 {
-    // Create a sf::Text object to draw the text, using a sf::Text constructor
-    sf::Text theText( text,        // text is a class data member
-                     theFont,     // font from a font file, passed as a parameter
-                     textSize);   // this is the size of text to be displayed
-    
-    // Text color is the designated one, unless the background is Yellow, in which case the text
-    // color gets changed to blue so we can see it, since we can't see white-on-yellow very well
-    if( this->getColor() == sf::Color::Yellow) {
-        theColor = sf::Color::Blue;
+    const char *p = text.c_str();
+    for( int found=0; found<count; found++) {
+        while( isspace( (unsigned char)*p)) {
+            p++;
+        }
+        const char *pStart = p;
+        if( *p == '-') {
+            p++;
+        }
+        while( isdigit( (unsigned char)*p)) {
+            p++;
+        }
+        if( *p == '\0') {
+            return 0;   // the number may go on
+        }
+        if( !isspace( (unsigned char)*p) || !isdigit( (unsigned char)p[ -1])) {
+            return -1;
+        }
+        values[ found] = atoi( pStart);
     }
-    theText.setColor( theColor);
-    
-    // Place text in the corresponding square, centered in both x (horizontally) and y (vertically)
-    // For horizontal center, find the center of the square and subtract half the width of the text
-    int theXPosition = xPosition + (size / 2) - ((strlen(text.c_str()) * theText.getCharacterSize()) / 2);
-    // For the vertical center, from the top of the square go down the amount: (square size - text size) / 2
-    int theYPosition = yPosition + (size - theText.getCharacterSize()) / 2;
-    // Use an additional offset to get it centered
-    int offset = 5;
-    theText.setPosition( theXPosition + offset, theYPosition - offset);
-    
-    // Finally draw the Text object in the RenderWindow
-    pWindow->draw( theText);
+    return 1;
+}
+
+
+// Fit the view, the board and the messages label to the window's size, when it opens
+// and whenever it is resized
+void fitWindow( sf::RenderWindow &window, BoardRenderer &renderer, sf::Text &messagesLabel)
+{
+    sf::Vector2u size = window.getSize();
+    window.setView( sf::View( sf::FloatRect( 0, 0, size.x, size.y)));
+    renderer.setArea( sf::FloatRect( 0, 0, size.x, std::max( 0, (int)size.y - MessageStripHeight)));
+    messagesLabel.setPosition( 0, (int)size.y - (int)messagesLabel.getCharacterSize() - 5);
 }
 
 
@@ -187,502 +193,511 @@ void displayInstructions()
     << "two originals. This value gets added to the score.  On each move    \n"
     << "one new randomly chosen value of 2 or 4 is placed in a random open  \n"
     << "square.  User input of x exits the game.                            \n"
+    << "  \n"
+    << "Keys can be pressed in the game window, where the arrow keys move   \n"
+    << "too, or typed in this terminal.                                     \n"
+    << "  \n"
+    << "User input of u takes back the last move, and y makes it again.     \n"
+    << "  \n"
+    << "User input of e lets the computer choose one move, and E lets it    \n"
+    << "play on by itself until the game ends, E again or a move of yours   \n"
+    << "stops it.                                                           \n"
+    << "  \n"
+    << "User input of o shows or hides how long each part of a move takes.  \n"
+    << "User input of h shows or hides a hint for the next move, found by   \n"
+    << "the computer while you think.                                       \n"
+    << "  \n"
+    << "User input of m turns the sliding of the tiles off and on.          \n"
     << "  \n";
 }//end displayInstructions()
 
-void Random1( int game[], int shapes)
-{
-    
-    int Pos = 2;
-    if( rand()%2 == 1) {      // for randomly selecting 2 or 4
-        Pos = 4;
-    }
-    
-    int temp1;
-    do {
-        temp1 = rand() % (shapes*shapes);
-    }while( game[ temp1] != 0);
-    
-    // blank index position
-    game[ temp1] = Pos;
-}
-
-//--------------------------------------------------------------------
 
-void BoardSet(
-              int play[],           
-              int BoardPrim[],   
-              int &blocks,   
-              int &Tile)
+int main( int argc, char *argv[])
 {
-    //  Initialization the array of int values used to represent the Ascii board
-   
-    for( int t =0; t <blocks; t++) {
-        for( int y =0; y <blocks; y++ ) {
-            play[ t*blocks + y] = 0;
+    // Check the bitboard move engine against the int[] moves, then exit
+    if( argc > 1 && strcmp( argv[ 1], "--check") == 0) {
+        if( !bitboardMatchesReference( 10000, 1) || !boardKeysMatchReference( 1000, 1)) {
+            return 1;
         }
+        std::cout << "Bitboard moves match the reference moves, and board keys their boards." << std::endl;
+        return 0;
     }
-    
-    // Displaying and Calculatinng game value
-    Tile = TileValue;        
-    for( int r=4; r<blocks; r++) {
-        Tile = Tile * 2;   
-    }
-    std::cout << "Game ends when you reach ";
-    std::cout << Tile << ".";
-    std::cout <<std::endl;
-    
-    // To Set two random pieces for starting the game
-    Random1( play, blocks);
-    Random1( play, blocks);
-}
-
-
 
-void BoardVisual( int play[], int block, int score)
-{
-    std::cout << "\n";
-    std::cout << "Score: ";
-    std::cout << score <<std::endl;
-    for( int x =0; x <block; x++) {
-        std::cout << "   ";
-        for( int y=0; y<block; y++ ) {    // to display the board on the screen
-            int temp1 = x*block + y;  
-            std::cout << std::setw( 6);    
-            
-            if( play[ temp1] == 0) {
-                std::cout << '.';
-            }
-            else {
-                std::cout << play[ temp1];
-            }
+    int move = 1;              
+    int score = 0;                    
+    int squaresPerSide = 4;           // User will enter this value.  Set default to 4
+    char Input = ' ';     // Stores user input
+    char sent[ 81];        // C-string to hold concatenated output of character literals
+    int board[ MaxBoardSize * MaxBoardSize];         
+    int Tile2 = TileValue;  
+    
+    // Every game prints its seed, so the same pieces can be placed again with --seed
+    uint64_t seed = std::random_device()();
+    int historyDepth = DefaultHistoryDepth;
+    const char *recordPath = NULL;
+    const char *aiName = "expectimax";
+    for( int i=1; i+1<argc; i+=2) {
+        if( strcmp( argv[ i], "--seed") == 0) {
+            seed = strtoull( argv[ i+1], NULL, 10);
         }
-        std::cout << "\n\n";
-    }
-}
-
-
-// To Make a board copy .Used after an attempted move
-// to see if the board actually changed.
-void duplicate(
-               int BoardOld[], 
-               int play[],         
-               int blocks)       
-{
-    for( int g =0; g <blocks; g++) {
-        for( int h=0; h<blocks; h++ ) {
-            int temp2 = g*blocks + h;  
-            BoardOld[ temp2] = play[ temp2];
+        else if( strcmp( argv[ i], "--history") == 0) {
+            historyDepth = atoi( argv[ i+1]);
         }
-    }
-}
-
-
-// Returning true if boards are different or false.
-bool Board1( int BoardOld[], int play[], int squaresPerSide)
-{
-    // To Compare the element by element.  If one is found that is different
-    // then return true, as board was changed.
-    for( int x =0; x <squaresPerSide; x++) {
-        for( int c=0; c<squaresPerSide; c++ ) {
-            int change = x*squaresPerSide + c;  
-            if( BoardOld[ change] != play[ change]) {
-                return true;
-            }
+        else if( strcmp( argv[ i], "--record") == 0) {
+            recordPath = argv[ i+1];
         }
-    }
-    
-    return false;  
-}
-
-
-
-void appendNode(Node* &pHead, int game[], int score, int step, int temp2)
-{
-    Node* pTemp = new Node; // create new node
-    duplicate(pTemp->Dupboard, game, temp2); // store the board in the new node
-    pTemp->score = score; // For storing the score in the new node
-    pTemp->step = step; // For storing the move number in the new node
-    pTemp->pNext = pHead; 
-    pHead = pTemp; 
-    
-} 
-
-
-
-
-void slideRight( int play[], int blocks, int &score)
-{
-    
-    for( int e=0; e<blocks; e++) {
-       
-        int limit = e * blocks + blocks - 1;
-        
-        
-        for( int col=blocks - 1; col>=0; col--) {
-            
-            // get 1-d array index based on row and col
-            int current = e * blocks + col;
-            
-            // slide current piece over as far right as possible
-            while( current < limit && play[ current+1] == 0) {
-                play[ current+1] = play[ current];
-                play[ current] = 0;
-                current++;
-            }
-            
-           
-            if( (current < limit) && (play[ current+1] == play[ current]) && (play[ current] != 0) ) {
-                play[ current+1] = play[ current+1] + play[ current];
-                play[ current] = 0;
-                limit = current;           // Reset row index limit, to prevent combining a piece more than once
-                score += play[ current+1];  // Update score
-            }
-            
-        }//end for( int col...
-    }//end for( int row...
-    
-}//end slideRight()
-
-
-//--------------------------------------------------------------------
-// Slide all tiles up, combining matching values, updating the score
-void Up1( int board[], int squaresPerSide, int &score)
-{
-    // handle each column separately
-    for( int col=0; col<squaresPerSide; col++) {
-        // set index limit for this column to be index of top-most tile on this row
-        int limit = col;
-        
-        
-        for( int row=1; row<squaresPerSide; row++) {
-            
-            
-            int current = row * squaresPerSide + col;
-            
-           
-            while( (current > limit) && (board[ current-squaresPerSide] == 0) ) {
-                board[ current-squaresPerSide] = board[ current];
-                board[ current] = 0;
-                current = current - squaresPerSide;
-            }
-            
-            
-            if( (current > limit) && (board[ current-squaresPerSide] == board[ current]) && (board[ current] != 0) ) {
-                board[ current-squaresPerSide] = board[ current-squaresPerSide] + board[ current];
-                board[ current] = 0;
-                limit = current;           // Reset row index limit, to prevent combining a piece more than once
-                score += board[ current-squaresPerSide];  // Update score
-            }
-            
-        }//end for( int col...
-    }//end for( int row...
-    
-}//end slideUp()
-
-void erase(Node* &pHead, int game[], int &score, int &step, int temp2)
-{
-    Node* pTemp = pHead; // create a new pointer and make it point to the
-    // head of the list
-    pHead = pHead->pNext; 
-    delete pTemp; 
-    duplicate(game, pHead->Dupboard,temp2); // change the contens of the board
-    score = pHead->score; // change the contents of score
-    step = pHead->step; 
-} 
-
-//--------------------------------------------------------------------
-// Slide all tiles down, combining matching values, updating the score
-void Down1( int play[], int squaresPerSide, int &score)
-{
-    // handle each column separately
-    for( int col=0; col<squaresPerSide; col++) {
-        // set index limit for this column to be index of bottom-most tile on this row
-        int limit = (squaresPerSide - 1) * squaresPerSide + col;
-        
-        // Start from the next to last row and process each element from bottom to top
-        for( int row=squaresPerSide-1; row>=0; row--) {
-            
-            // get 1-d array index based on row and col
-            int current = row * squaresPerSide + col;
-            
-            // slide current piece down as far as possible
-            while( current < limit && play[ current+squaresPerSide] == 0 ) {
-                play[ current+squaresPerSide] = play[ current];
-                play[ current] = 0;
-                current = current + squaresPerSide;
-            }
-            
-            // Combine it with lower neighbor if values are the same and non zero.
-            // The additional check for (current < limit) ensures a tile can be combined
-            // at most once on a move, since limit is moved up every time a combination is made.
-            if( (current < limit) && (play[ current+squaresPerSide] == play[ current]) && (play[ current] != 0) ) {
-                play[ current+squaresPerSide] = play[ current+squaresPerSide] + play[ current];
-                play[ current] = 0;
-                limit = current;           // Reset row index limit, to prevent combining a piece more than once
-                score += play[ current+squaresPerSide];  // Update score
-            }
-            
-        }//end for( int col...
-    }//end for( int row...
-    
-}//end slideDown()
-void Left1( int game[], int shapes, int &score)
-{
-    // handle each row separately
-    for( int s=0; s<shapes; s++) {
-        // set index limit for this row to be index of left-most tile on this row
-        int limit = s * shapes;
-        
-        // Start from the second column and process each element from left to right
-        for( int r=1; r<shapes; r++) {
-            
-            // get 1-d array index based on row and col
-            int current = s * shapes + r;
-            
-            // slide current piece over as far left as possible
-            while( current > limit && game[ current-1] == 0) {
-                game[ current-1] = game[ current];
-                game[ current] = 0;
-                current--;
-            }
-            
-            // Combine it with left neighbor if values are the same and non zero.
-            // The additional check for (current > limit) ensures a tile can be combined
-            // at most once on a move, since limit is moved right every time a combination is made.
-            // This ensures a row of:  2 2 4 4   ends up correctly as:  4 8 0 0   and not:  8 4 0 0
-            if( (current > limit) && (game[ current-1] == game[ current]) && (game[ current] != 0) ) {
-                game[ current-1] = game[ current-1] + game[ current];
-                game[ current] = 0;
-                limit = current;           // Reset row index limit, to prevent combining a piece more than once
-                score += game[ current-1];  // Update score
-            }
-            
-        }//end for( int col...
-    }//end for( int row...
-    
-}//end slideLeft()
-
-
-
-
-bool gameEnds( int play[],      // current play
-              int blocks,    // size of one side of board
-              int Tile) // max tile value for this size board
-{
-    // See if the Tile2 is found anywhere on the board.
-    // If so, game is over.
-    for( int d =0; d <blocks*blocks; d ++) {
-        if( play[ d] == Tile) {
-            std::cout << "Congratulations!  You made it to ";
-            std::cout << Tile << " !!!" <<std::endl;
-            return true;  // game is over
+        else if( strcmp( argv[ i], "--ai") == 0) {
+            aiName = argv[ i+1];
         }
-    }
-    
-    // See if there are any open squares.  If so return true since we aren't done
-    for( int d=0; d<blocks*blocks; d++) {
-        if( play[ d] == 0) {
-            return false;  // there are open squares, so game is not over
+        else if( strcmp( argv[ i], "--weights") == 0 && !setPolicyWeights( argv[ i+1])) {
+            std::cout << "Only one --weights file can be given." << std::endl;
+            return 1;
         }
-    }
-    
-    // All squares are full.
-    // To check if board is done, make a copy of board, then slide left
-    // and slide down.  If resulting board is same as original, we are done
-    // with game since there are no moves to be made.
-    int Dupboard[ blocks * blocks];
-    duplicate( Dupboard, play, blocks);
-    int num5 = 0;   // used as a placeHolder only for function calls below
-    Left1( Dupboard, blocks, num5);
-    Down1( Dupboard, blocks, num5);
-    
-    // Compare each square of boards.  If any is different, a move is possible
-    for( int i=0; i<blocks*blocks; i++) {
-        if( Dupboard[ i] != play[ i]) {
-            return false;  // Game is not over
+        else if( strcmp( argv[ i], "--profile") == 0 && !profileLogOpen( argv[ i+1], ProfileLogSeconds)) {
+            std::cout << "Unable to create " << argv[ i+1] << std::endl;
+            return 1;
         }
     }
+    GameRng rng( seed);
+    UndoHistory history( historyDepth);
+    
+    // Every move, undo and redo is recorded when --record is given
+    RecordWriter records;
+    GameRecord record;
+    int gameNumber = 0;
+    if( recordPath != NULL && !records.open( recordPath)) {
+        std::cout << "Unable to create " << recordPath << std::endl;
+        return 1;
+    }
     
-    std::cout << "\n";
-    std::cout << "No more available moves.  ";
-    std::cout << "Game is over.\n";
-    std::cout << "\n";
-    return true;  // Game is over since all squares are full and there are no moves
-}//end gameEnds()
-
-int main()
-{
-    int arraySize = 4;
-    int move = 1;              
-    int score = 0;                    
-    int squaresPerSide = 4;           // User will enter this value.  Set default to 4
-    char Input = ' ';     // Stores user input
-    char sent[ 81];        // C-string to hold concatenated output of character literals
-    int var1 = 0, var2 = 0;                                                                                                //    if a move changed the board.
-    int board[ MaxBoardSize * MaxBoardSize];         
-    int BoardPrim[ MaxBoardSize * MaxBoardSize];  
-    int Tile2 = TileValue;  
+    // Computer player, by default searching its four possible moves in parallel
+    ThreadPool aiPool;
+    MovePolicy *pAi = createPolicy( aiName, &aiPool);
+    if( pAi == NULL) {
+        std::cout << "Unknown computer player '" << aiName << "'.  Choose one of: " << policyNames() << std::endl;
+        return 1;
+    }
+    bool autoplay = false;   // turned on and off by E, so the computer keeps moving without prompting
     
-    Square squaresArray[ MaxBoardSize * MaxBoardSize];
+    // Hints are searched on their own thread after every change to the board, and shown
+    // as each depth finishes, so the window never waits for them
+    HintService hints;
+    bool showHints = false;
+    char hintText[ 81] = "";
     
     // Create and initialize the font, to be used in displaying text.
     sf::Font font;
     initializeFont( font);
    
     sf::RenderWindow window(sf::VideoMode(WindowXSize, WindowYSize), "Program 5: 1024");
+    window.setFramerateLimit( FrameLimit);
+    BoardRenderer renderer( font);
     
     // Create the messages label at the bottom of the screen, to be used in displaying debugging information.
     sf::Text messagesLabel( "Welcome to 1024", font, 24);
     // Make a text object from the font
     messagesLabel.setColor(sf::Color::White);
-    // Place text at the bottom of the window. Position offsets are x,y from 0,0 in upper-left of window
-    messagesLabel.setPosition( 0, WindowYSize - messagesLabel.getCharacterSize() - 5);
+    // Place text at the bottom of the window, and the board in the rest of it
+    fitWindow( window, renderer, messagesLabel);
     
-    displayInstructions();
+    // Phase timings, shown to the right of the messages label by the o key
+    sf::Text overlayLabel( "", font, OverlayTextSize);
+    overlayLabel.setColor( sf::Color::Yellow);
+    ProfileSnapshot overlayLast = profileSnapshot();
+    bool showOverlay = false;
     
-    // Get the board size, create and initialize the board, and set the max tile value
-    BoardSet( board, BoardPrim, squaresPerSide, Tile2);
-    
-    Node* pHead = NULL;
-    
-    // creating a new node to store the initial board information in the list
-    Node* pTemp = new Node;
-    duplicate(pTemp->Dupboard, board, squaresPerSide); // storing a copy of the board
-    pTemp->step = move; // storing the initial move number
-    pTemp->score = score; // storing the score in the game
-    
-    pTemp->pNext = NULL;  // moving to the next node
-    pHead = pTemp; // make the pHead point to the node
+    // Tiles slide to their new squares unless m turns it off
+    bool animate = true;
+    MoveMotions motions;
+    int before[ MaxBoardSize * MaxBoardSize];   // the board before the move being animated
     
+    displayInstructions();
+    std::cout << "Game seed: " << seed << std::endl;
     
+    // Get the board size, create and initialize the board, and set the max tile value
+    BoardSet( board, squaresPerSide, Tile2, rng);
+    // Pick the move functions compiled for this board size
+    const BoardKernels *pKernels = &boardKernels( squaresPerSide);
+    // Empty squares and largest tile, kept up to date so the end of the game is found
+    // without a pass over the board after every move
+    BoardSummary summary = pKernels->summarize( board);
+    
+    // Keep the initial board, score and move number for undo
+    history.reset( squaresPerSide);
+    history.push( board, score, move);
+    record.setOrigin( seed, gameNumber);
+    record.begin( squaresPerSide, Tile2, board);
+    
+    
+    
+    // Moves come from keys pressed in the window or typed in the terminal, whichever
+    // arrives first.  The board is only drawn again after something has changed.
+    TerminalInput terminal;
+    LoopStats loopStats = { 0, 0, 0, std::chrono::steady_clock::now() };
+    std::chrono::steady_clock::time_point inputTime;
+    bool redraw = true;         // the board changed since it was last drawn
+    bool repaint = false;       // only the window needs drawing again, after a resize or for a slide
+    bool inputPending = false;  // an input is waiting to be shown, for the latency figures
+    char argumentsFor = 0;      // r or p while its numbers are being typed, a key at a time
+    std::string argumentText;   // what has been typed of them
+    int arguments[ 2];
     
     while (window.isOpen())
     {
-        //             char c='P';
-        var1 = 0;
-        var2 = 0;
+        Hint hint;
+        if( showHints && hints.poll( hint)) {
+            sprintf( hintText, "   Hint: %c (depth %d)", hint.direction, hint.depth);
+            repaint = true;
+        }
         
-        for(int num2 = 0; num2 < squaresPerSide * squaresPerSide; num2++)
-        {
-           
-            char ident[ 81];
-            // Squares with a 0 value should not have a number displayed
-            if( board[ num2] == 0)
+        if( redraw || repaint) {
+            int drawCalls = 0;
             {
-                strcpy( ident, "");   // "print" a blank text string
-            } // if( board[ i] == 0)
-            else
+                PROFILE_SCOPE( TimerDraw);
+                window.clear();
+                
+                // Bring the squares up to date with the board and draw them
+                renderer.update( board, squaresPerSide);
+                drawCalls += renderer.draw( window);
+                
+                // Construct string to be displayed at bottom of screen
+                if( argumentsFor != 0) {
+                    sprintf( sent, "Move %d   %c %s_", move, argumentsFor, argumentText.c_str());
+                }
+                else {
+                    sprintf( sent, "Move %d%s", move, hintText);
+                }
+                messagesLabel.setString( sent);            // Store the string into the messagesLabel
+                window.draw( messagesLabel);                  // Display the messagesLabel
+                drawCalls++;
+                
+                if( showOverlay) {
+                    overlayLabel.setString( profileOverlay( overlayLast));
+                    sf::FloatRect label = messagesLabel.getGlobalBounds();
+                    overlayLabel.setPosition( label.left + label.width + 10,
+                                              window.getSize().y - overlayLabel.getLocalBounds().height - 10);
+                    window.draw( overlayLabel);
+                    drawCalls++;
+                }
+            }
+           
             {
-                sprintf( ident, "%d", board[ num2]);   // "print" the square creation order number into a string to be stored in the square
-            } // else ends
-            // Set each array pointer have the address of a new Square, created with a Square constructor
-            squaresArray[ num2] = Square(55, 55*var1 + var1*10, 55*var2 + var2*10, sf::Color::White, true, ident);
-            // Draw the square
-            window.draw( squaresArray[ num2].getTheSquare());
-            // Draw the text associated with the Square, in the window with the indicated color and text size
-            int red = 0, green = 0, blue = 0; // initialize the RGB
-            squaresArray[num2].displayText( &window, font, sf::Color(red, green, blue), 30);
+                PROFILE_SCOPE( TimerPresent);
+                window.display();
+            }
+            PROFILE_COUNT( CounterFrames, 1);
+            PROFILE_COUNT( CounterDrawCalls, drawCalls);
+            if( inputPending) {
+                double latency = std::chrono::duration<double>( std::chrono::steady_clock::now() - inputTime).count();
+                loopStats.inputs++;
+                loopStats.latencySum += latency;
+                loopStats.latencyMax = std::max( loopStats.latencyMax, latency);
+                inputPending = false;
+            }
             
-            // check if we have reached the end of the row
-            if((num2 + 1) % 4 == 0)
-            {
-                var1 = 0;
-                var2 ++;
-            } // if((i + 1) % 4 == 0) ends
-            else
-            {
-                var1++;
-            } // else ends
-        } // for i ends
-        
-        // Construct string to be displayed at bottom of screen
-        sprintf( sent, "Move %d", move);          
-        messagesLabel.setString( sent);            // Store the string into the messagesLabel
-        window.draw( messagesLabel);                  // Display the messagesLabel
-       
-        window.display();
-        
-        //defining pHead and initialising it to NULL
-        
-        // Display both the graphical and text boards.
-        BoardVisual( board, squaresPerSide, score);
+            repaint = renderer.animating();   // a slide is drawn again on every frame until it is over
+            if( redraw) {
+                // Display both the graphical and text boards.
+                PROFILE_SCOPE( TimerConsole);
+                BoardVisual( board, squaresPerSide, score);
+                
+                std::cout << "List: ";
+                for(int x = move; x > history.oldestStep(); x--)
+                {
+                    std::cout << x << "->";
+                } // for x ends
+                std::cout << history.oldestStep();
+                std::cout << endl;
+                std::cout << endl;
+                
+                // Prompt for user input
+                std::cout << move << ". Your move: " << std::flush;
+                redraw = false;
+                
+                if( showHints && !autoplay) {
+                    hints.start( board, squaresPerSide);
+                }
+            }
+        }
         
-        std::cout << "List: ";
-        for(int x = move; x > 0; x--)
+        // Take the next command from the window, the computer or the terminal.  Waiting
+        // on the terminal for a moment keeps the loop from spinning while idle.
+        Input = 0;
+        bool autoMove = false;   // the e below was made up for autoplay, not typed
         {
-            if(x != 1)
-                std::cout << x << "->";
-            else
-                std::cout << "1";
-        } // for x ends
-        std::cout << endl;
-        std::cout << endl;
+            PROFILE_SCOPE( TimerEvents);
+            sf::Event event;
+            while( Input == 0 && window.pollEvent( event)) {
+                if( event.type == sf::Event::Closed) {
+                    Input = 'x';
+                }
+                else if( event.type == sf::Event::Resized) {
+                    fitWindow( window, renderer, messagesLabel);
+                    repaint = true;
+                }
+                else if( argumentsFor != 0) {
+                    Input = windowCharacter( event);
+                    if( Input != 0) {
+                        std::cout << (Input == '\r' ? '\n' : Input) << std::flush;   // echoed as typed
+                    }
+                }
+                else {
+                    Input = windowCommand( event);
+                    if( Input != 0) {
+                        std::cout << Input << endl;   // echo keys pressed in the window on the terminal
+                    }
+                }
+            }
+        }
+        if( Input == 0 && autoplay && argumentsFor == 0 && !renderer.animating()) {
+            Input = 'e';
+            autoMove = true;
+            std::cout << "e" << endl;
+        }
+        if( Input == 0) {
+            PROFILE_SCOPE( TimerIdle);
+            int waitMs = renderer.animating() ? 0 : IdleWaitMs;
+            if( argumentsFor != 0 ? !terminal.character( Input, waitMs) : !terminal.key( Input, waitMs)) {
+                Input = 0;
+            }
+        }
+        profileLogTick();
+        if( Input == 0) {
+            continue;
+        }
         
-        duplicate( BoardPrim, board, squaresPerSide);  // copy from board into BoardPrim
+        // E again, a move typed by hand or anything else that changes the board stops autoplay
+        if( autoplay && !autoMove && argumentsFor == 0 && strchr( "Eewasduyrp", Input) != NULL) {
+            autoplay = false;
+            std::cout << "Autoplay stopped." << endl;
+            if( Input == 'E') {
+                continue;
+            }
+        }
         
-        // Prompt for and handle user input
-        std::cout << move << ". Your move: ";
-        std::cin >> Input;
+        // The numbers after r and p are gathered a key at a time, so that the window is
+        // still drawn and can be closed while they are typed.  Escape gives up on them.
+        if( argumentsFor != 0) {
+            repaint = true;
+            if( Input == '\x1b') {
+                std::cout << "\nCancelled." << endl;
+                argumentsFor = 0;
+                redraw = true;
+                continue;
+            }
+            if( Input == '\b') {
+                if( !argumentText.empty()) {
+                    argumentText.erase( argumentText.size() - 1);
+                }
+                continue;
+            }
+            if( argumentText.size() < MaxArgumentLength) {
+                argumentText += Input;
+            }
+            int complete = readArguments( argumentText, argumentsFor == 'p' ? 2 : 1, arguments);
+            if( complete == 0) {
+                continue;
+            }
+            Input = (complete > 0) ? argumentsFor : '#';   // '#' for numbers that could not be read
+            argumentsFor = 0;
+        }
+        else if( Input == 'r' || Input == 'p') {
+            if( Input == 'r') {
+                std::cout << "\n"
+                << "Resetting board \n"
+                << "\n";
+                // Prompt for board size
+                std::cout << "Enter the size board you want, between 4 and " << MaxBoardSize << ": " << std::flush;
+            }
+            else {
+                std::cout << "Enter the square and the value to place there: " << std::flush;
+            }
+            argumentsFor = Input;
+            argumentText.clear();
+            repaint = true;
+            continue;
+        }
+        inputTime = std::chrono::steady_clock::now();
+        inputPending = true;
+        redraw = true;
+        hints.cancel();   // the hint is for the board before this key, so stop working on it
+        hintText[ 0] = '\0';
+        
+        char direction = Input;   // the direction slid, if this is a move
+        MoveResult moved = { 0, 0, false };   // set by the moves, to tell if the board changed
+        // Where the tiles go, for sliding them on screen; the moves only work this out
+        // when it is asked for
+        MoveMotions *pMotions = animate ? &motions : NULL;
+        if( animate) {
+            pKernels->duplicate( before, board);
+        }
         switch (Input) {
             case 'x':
                 std::cout << "Thanks for playing.";
                 std::cout << " Exiting program... \n\n";
+                record.end( score, move - 1, board);
+                records.write( record);
+                if( recordPath != NULL && !records.close()) {
+                    std::cout << "Unable to write every game to " << recordPath << std::endl;
+                }
+                profileLogClose();
+                reportLoopStats( loopStats);
                 exit( 0);
                 break;
             case 'u':
                 // Undo the move to the previous move
-                if(pHead->step == 1)
+                if( history.size() == 1 && history.oldestStep() == 1)
                 {
                     std::cout << "*** You cannot undo past ";
                     std::cout << "the beginning of the game.  ";
                     std::cout << "Please retry. ***" << endl;
                     continue;
-                } // if(pHead->step == 1) ends
+                } // if at the start of the game ends
+                else if( history.size() == 1)
+                {
+                    std::cout << "*** Only the last " << history.depth() << " or so moves ";
+                    std::cout << "are kept for undo.  ";
+                    std::cout << "Please retry. ***" << endl;
+                    continue;
+                } // if history used up ends
                 else
                 {
                     std::cout << "* Undoing move *" << endl;
-                    erase(pHead, board, score, move, squaresPerSide);
+                    PROFILE_SCOPE( TimerHistory);
+                    history.pop( board, score, move);
+                    summary = pKernels->summarize( board);
+                    record.undo();
                 } // else ends
-                window.clear();
+                continue;
+                break;
+                
+            case 'y':
+                // Redo the move that was last undone
+                if( !history.redo( board, score, move))
+                {
+                    std::cout << "*** There is no undone move to redo.  ";
+                    std::cout << "Please retry. ***" << endl;
+                    continue;
+                }
+                std::cout << "* Redoing move *" << endl;
+                summary = pKernels->summarize( board);
+                record.redo();
                 continue;
                 break;
                 
             case 'r':
-                std::cout << "\n"
-                << "Resetting board \n"
-                << "\n";
-                // Prompt for board size
-                std::cout << "Enter the size board you want, between 4 and 12: ";
-                move >> squaresPerSide;
-                std:: cin>>squaresPerSide;
-                BoardSet( board, BoardPrim, squaresPerSide, Tile2);
+                if( arguments[ 0] < 4 || arguments[ 0] > MaxBoardSize) {
+                    std::cout << "The board size must be between 4 and " << MaxBoardSize << "." << endl;
+                    continue;
+                }
+                squaresPerSide = arguments[ 0];
+                record.end( score, move - 1, board);
+                records.write( record);
+                BoardSet( board, squaresPerSide, Tile2, rng);
+                pKernels = &boardKernels( squaresPerSide);
+                summary = pKernels->summarize( board);
                 score = 0;
                 move = 1;
+                history.reset( squaresPerSide);
+                history.push( board, score, move);
+                record.setOrigin( seed, ++gameNumber);
+                record.begin( squaresPerSide, Tile2, board);
                 continue;  
                 break;
             case 'd':
-                slideRight( board, squaresPerSide, score); // Slide right
+            {
+                PROFILE_SCOPE( TimerMove);
+                moved = applyMove( *pKernels, board, 'd', score, pMotions); // Slide right
                 break;
+            }
             case 'a':
-                Left1( board, squaresPerSide, score);  // Slide left
+            {
+                PROFILE_SCOPE( TimerMove);
+                moved = applyMove( *pKernels, board, 'a', score, pMotions);  // Slide left
                 break;
+            }
             case 'p':
-                
-                int temp4;  // 1-d array index location to place piece
-                int temp5;  // value to be placed
-                std::cin >> temp4 >> temp5;
+            {
+                int temp4 = arguments[ 0];  // 1-d array index location to place piece
+                int temp5 = arguments[ 1];  // value to be placed
+                // The computer player packs a 4x4 board four bits to a square, so tiles there stay below 2^15
+                if( temp4 < 0 || temp4 >= squaresPerSide * squaresPerSide || !placeableTile( temp5)
+                    || (squaresPerSide == 4 && temp5 >= (1 << 15))) {
+                    std::cout << "Enter p, then the square and a power of two to place there." << endl;
+                    continue;
+                }
                 board[ temp4] = temp5;
+                summary = pKernels->summarize( board);   // the piece may cover another, or a 0 clear one
+                record.place( temp4, temp5);
                 continue;  // Do not increment move number or place random piece
                 break;
+            }
+                
+            case '#':
+                std::cout << "Please enter whole numbers after r and p." << endl;
+                continue;
+                break;
                 
             case 's':
-                Down1( board, squaresPerSide, score);  // Slide down
+            {
+                PROFILE_SCOPE( TimerMove);
+                moved = applyMove( *pKernels, board, 's', score, pMotions);  // Slide down
                 break;
+            }
                 
             case 'w':
-                Up1( board, squaresPerSide, score);    // Slide up
+            {
+                PROFILE_SCOPE( TimerMove);
+                moved = applyMove( *pKernels, board, 'w', score, pMotions);    // Slide up
+                break;
+            }
+                
+            case 'o':
+                showOverlay = !showOverlay;
+                continue;
+                break;
+                
+            case 'h':
+                showHints = !showHints;
+                std::cout << "Hints are " << (showHints ? "shown." : "hidden.") << endl;
+                continue;
+                break;
+                
+            case 'm':
+                animate = !animate;
+                std::cout << "Moves are " << (animate ? "animated." : "shown at once.") << endl;
+                continue;
+                break;
+                
+            case 'E':
+                autoplay = true;   // only reached while autoplay is off; E turns it off above
+                // fall through, to make the first computer move
+            case 'e':
+            {
+                // Let the computer choose the direction, then slide as if it had been typed
+                char choice;
+                {
+                    PROFILE_SCOPE( TimerSearch);
+                    choice = pAi->chooseMove( board, squaresPerSide, rng);
+                }
+                {
+                    PROFILE_SCOPE( TimerMove);
+                    moved = applyMove( *pKernels, board, choice, score, pMotions);
+                }
+                direction = choice;
+                const ExpectimaxPolicy *pSearch = dynamic_cast<const ExpectimaxPolicy *>( pAi);
+                if( pSearch != NULL) {
+                    const SearchStats &search = pSearch->lastSearch();
+                    std::cout << "Computer moves " << choice << ": depth " << pSearch->lastDepth()
+                              << ", " << search.nodes << " nodes, "
+                              << (long)(search.nodes / (search.seconds > 0 ? search.seconds : 1)) << " nodes/sec, "
+                              << 100 * search.hits / (search.lookups > 0 ? search.lookups : 1) << "% table hits" << endl;
+                }
+                else {
+                    std::cout << "Computer moves " << choice << ", valued at " << pAi->moveValue() << endl;
+                }
                 break;
+            }
                 
             default:
                 std::cout << "Invalid input,";
@@ -692,30 +707,54 @@ int main()
         }//end switch( Input)
        
         
-        if( Board1( BoardPrim, board, squaresPerSide)) {
+        summarizeMove( summary, moved);
+        if( moved.changed) {
+            if( pMotions != NULL) {
+                renderer.animate( before, motions);
+            }
+            
             // Place a random piece on board
-            Random1( board, squaresPerSide);
+            int square;
+            {
+                PROFILE_SCOPE( TimerSpawn);
+                square = Random1( board, squaresPerSide, rng);
+                summarizeSpawn( summary, board[ square]);
+            }
+            {
+                PROFILE_SCOPE( TimerRecord);
+                record.move( direction, square, board[ square]);
+            }
             
             // Update move number after a valid move
             move++;
-            // Prepending a new node in the list
-            appendNode(pHead, board, score, move, squaresPerSide);
+            PROFILE_COUNT( CounterMoves, 1);
+            // Keep the new board for undo
+            PROFILE_SCOPE( TimerHistory);
+            history.push( board, score, move);
         }
         
         // See if we're done
-        if( gameEnds( board, squaresPerSide, Tile2)) {
+        GameStatus status;
+        {
+            PROFILE_SCOPE( TimerGameStatus);
+            status = gameStatusFrom( *pKernels, board, summary, Tile2);
+        }
+        if( reportGameEnd( status, Tile2)) {
             // Display the final board
             BoardVisual( board, squaresPerSide, score);
+            record.end( score, move - 1, board);
+            records.write( record);
             break;
         }
         
-        // Clear the screen
-        window.clear();
-        
-        // Pause the event loop, so that Codio does not think it is a runaway process and kill it after some time
-        std::this_thread::sleep_for(std::chrono::milliseconds( 10));
-        
     }//end while( window.isOpen())
     
+    if( recordPath != NULL && !records.close()) {
+        std::cout << "Unable to write every game to " << recordPath << std::endl;
+    }
+    profileLogClose();
+    reportLoopStats( loopStats);
+    delete pAi;
+    
     return 0;
 }//end main()
@@ -0,0 +1,160 @@
+//
+// Monte Carlo rollout player.  See montecarlo.h.
+//
+#include "montecarlo.h"
+#include <chrono>            // For steady_clock
+#include <functional>
+#include <vector>
+#include "game.h"
+#include "boardkernels.h"
+#include "threadpool.h"
+
+typedef std::chrono::steady_clock Clock;
+
+
+const char RolloutOrder[] = { 'w', 'a', 's', 'd' };
+const long DeadlineCheckMoves = 256;   // moves between looks at the clock during a playout
+
+
+// Totals kept by one thread of playouts, added up when they are all done
+struct RolloutTotals
+{
+    double points[ 4];   // scores of the playouts, per direction, as far as each got
+    long playouts[ 4];
+    long moves;          // random moves made, in finished playouts or not
+
+    RolloutTotals() : moves( 0)
+    {
+        for( int d=0; d<4; d++) {
+            points[ d] = 0;
+            playouts[ d] = 0;
+        }
+    }
+};
+
+
+//--------------------------------------------------------------------
+// Make random moves, each followed by a new piece, until gameStatus says stop or the
+// deadline passes.  Returns the points scored up to then.
+static int playout( int board[], const BoardKernels &kernels, int Tile, GameRng &rng,
+                    long &moves, const Clock::time_point &deadline)
+{
+    int squaresPerSide = kernels.squaresPerSide;
+    BoardSummary summary = kernels.summarize( board);
+    int score = 0;
+    while( gameStatusFrom( kernels, board, summary, Tile) == GameContinues) {
+        // A random direction, or the next one round that changes the board
+        int first = rng.below( 4);
+        MoveResult move = { 0, 0, false };
+        for( int d=0; d<4 && !move.changed; d++) {
+            move = applyMove( kernels, board, RolloutOrder[ (first + d) & 3], score);
+        }
+        summarizeMove( summary, move);
+        int square = Random1( board, squaresPerSide, rng);
+        summarizeSpawn( summary, board[ square]);
+        moves++;
+        if( moves % DeadlineCheckMoves == 0 && Clock::now() >= deadline) {
+            break;   // scored from the board it reached, as if the game ended there
+        }
+    }
+    return score;
+}
+
+
+MonteCarloPolicy::MonteCarloPolicy( ThreadPool *pPool, double budgetMs)
+    : pPool( pPool), budgetMs( budgetMs), value( 0)
+{
+}
+
+
+char MonteCarloPolicy::chooseMove( const int board[], int squaresPerSide, GameRng &rng)
+{
+    Clock::time_point start = Clock::now();
+    Clock::time_point deadline = start + std::chrono::microseconds( (long)(budgetMs * 1000));
+    const BoardKernels &kernels = boardKernels( squaresPerSide);
+    int Tile = winningTile( squaresPerSide);
+    int legal = kernels.legalMoves( board);
+
+    // Points of each legal move on its own, for a direction that gets no playout at all
+    double onePly[ 4];
+    for( int d=0; d<4; d++) {
+        int play[ MaxBoardSize * MaxBoardSize];
+        int score = 0;
+        kernels.duplicate( play, (int *)board);
+        applyMove( kernels, play, RolloutOrder[ d], score);
+        onePly[ d] = score;
+    }
+
+    // Each thread takes the directions in turn, starting from a different one, until
+    // the time is up.  Every playout stops at the deadline, the last ones part way
+    // through, so the budget holds on boards of any size.
+    int tasks = (pPool != NULL) ? pPool->size() + 1 : 1;
+    std::vector<RolloutTotals> totals( tasks);
+    uint64_t seed = rng.next();
+    std::function<void( int)> rollouts = [&]( int task) {
+        GameRng taskRng( seed, task);
+        RolloutTotals &mine = totals[ task];
+        for( int round=0; legal != 0; round++) {
+            int d = (task + round) & 3;
+            if( (legal & directionBit( RolloutOrder[ d])) == 0) {
+                continue;
+            }
+            if( Clock::now() >= deadline) {
+                break;
+            }
+            int play[ MaxBoardSize * MaxBoardSize];
+            int score = 0;
+            kernels.duplicate( play, (int *)board);
+            applyMove( kernels, play, RolloutOrder[ d], score);
+            Random1( play, squaresPerSide, taskRng);
+            mine.points[ d] += score + playout( play, kernels, Tile, taskRng, mine.moves, deadline);
+            mine.playouts[ d]++;
+        }
+    };
+    if( pPool != NULL) {
+        pPool->parallelFor( tasks, rollouts);
+    }
+    else {
+        rollouts( 0);
+    }
+
+    // The direction with the best mean score, or the best move on its own for directions
+    // the time ran out before
+    last = SearchStats();
+    int best = -1;
+    double bestMean = 0;
+    for( int d=0; d<4; d++) {
+        double points = 0;
+        long playouts = 0;
+        for( int t=0; t<tasks; t++) {
+            points += totals[ t].points[ d];
+            playouts += totals[ t].playouts[ d];
+        }
+        last.playouts += playouts;
+        if( (legal & directionBit( RolloutOrder[ d])) == 0) {
+            continue;
+        }
+        double mean = (playouts > 0) ? points / playouts : onePly[ d];
+        if( best < 0 || mean > bestMean) {
+            best = d;
+            bestMean = mean;
+        }
+    }
+    for( int t=0; t<tasks; t++) {
+        last.nodes += totals[ t].moves;
+    }
+    value = bestMean;
+    last.seconds = std::chrono::duration<double>( Clock::now() - start).count();
+    total.nodes += last.nodes;
+    total.playouts += last.playouts;
+    total.seconds += last.seconds;
+    return RolloutOrder[ best >= 0 ? best : 0];
+}
+
+
+void MonteCarloPolicy::addStats( SearchStats &totals) const
+{
+    totals.nodes += total.nodes;
+    totals.playouts += total.playouts;
+    totals.seconds += total.seconds;
+}
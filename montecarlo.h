@@ -0,0 +1,42 @@
+//
+// Monte Carlo rollout player.
+//
+// Instead of searching the game tree, plays many games to the end from each direction
+// that changes the board: the move, a new piece placed by Random1, then random moves
+// and pieces until the game is over.  The direction whose games score best on average
+// is chosen.  The playouts are shared among the pool's threads and all stop when the
+// time budget for the move runs out, those still going scored as far as they got, so
+// a move takes about the same time on any board, and the answer improves with every
+// playout there is time for.
+//
+#ifndef MONTECARLO_H
+#define MONTECARLO_H
+
+#include "policy.h"
+
+
+const double DefaultRolloutMs = 5;   // time spent choosing each move
+
+
+class MonteCarloPolicy : public MovePolicy
+{
+public:
+    // Playouts run on pPool's threads and the caller's, or the caller's alone if it is NULL
+    explicit MonteCarloPolicy( ThreadPool *pPool = NULL, double budgetMs = DefaultRolloutMs);
+
+    char chooseMove( const int board[], int squaresPerSide, GameRng &rng);
+    void addStats( SearchStats &totals) const;
+    double moveValue() const { return value; }
+
+    // Counters of the most recent chooseMove: playouts, moves played in them, and time
+    const SearchStats &lastSearch() const { return last; }
+
+private:
+    ThreadPool *pPool;
+    double budgetMs;
+    SearchStats total;
+    SearchStats last;
+    double value;          // mean final score of the chosen direction
+};
+
+#endif
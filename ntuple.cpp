@@ -0,0 +1,366 @@
+//
+// N-tuple network player.  See ntuple.h.
+//
+#include "ntuple.h"
+#include <algorithm>         // For min()
+#include <chrono>            // For steady_clock
+#include <cstring>           // For memcmp(), memcpy()
+#include <iomanip>           // used for setting output field size using setw
+#include <mutex>
+#include <string>
+#include <random>            // For random_device, to name a new weights file
+#include <vector>
+#include <fcntl.h>           // For open()
+#include <sys/mman.h>        // For mmap()
+#include <sys/stat.h>        // For fstat()
+#include <unistd.h>          // For close(), ftruncate()
+#include "game.h"
+#include "boardkernels.h"
+#include "boardkey.h"
+#include "simulate.h"
+#include "threadpool.h"
+
+
+const char NetworkMagic[] = "1024NT01";
+const char TrainOrder[] = { 'w', 'a', 's', 'd' };
+
+// Squares of each tuple, indexed as in the int[] board: two rows of six along an edge
+// and one row in, and two 2x3 blocks, the usual choice for the 4x4 game
+const int Tuples[ TupleCount][ TupleSquares] = {
+    { 0, 1, 2, 3, 4, 5 },
+    { 4, 5, 6, 7, 8, 9 },
+    { 0, 1, 2, 4, 5, 6 },
+    { 4, 5, 6, 8, 9, 10 }
+};
+
+const int Lookups = TupleCount * BoardSymmetries;   // weights summed for one board
+
+
+struct NetworkHeader
+{
+    char magic[ 8];
+    uint32_t tuples;
+    uint32_t squares;
+    uint64_t games;
+    uint64_t origin;     // random, chosen when the file is made; 0 in files made before it was kept
+    char padding[ 32];
+};
+
+
+static size_t networkLength()
+{
+    return sizeof( NetworkHeader) + (size_t)TupleCount * TupleEntries * sizeof( float);
+}
+
+
+// Index into a tuple's table: the exponents on its squares, the first in the low bits
+static inline uint32_t tupleIndex( uint64_t key, const int squares[])
+{
+    uint32_t index = 0;
+    for( int j=0; j<TupleSquares; j++) {
+        index |= (uint32_t)((key >> (4 * squares[ j])) & 0xF) << (4*j);
+    }
+    return index;
+}
+
+
+//--------------------------------------------------------------------
+NTupleNetwork::NTupleNetwork()
+    : fd( -1), length( 0), pHeader( NULL), pWeights( NULL)
+{
+}
+
+
+NTupleNetwork::~NTupleNetwork()
+{
+    close();
+}
+
+
+bool NTupleNetwork::open( const char *path, bool writable)
+{
+    close();
+    struct stat info;
+    if( stat( path, &info) != 0) {
+        if( !writable) {
+            return false;
+        }
+        // A new file is all zeros past the header, which is every weight 0
+        NetworkHeader header;
+        memset( &header, 0, sizeof( header));
+        memcpy( header.magic, NetworkMagic, sizeof( header.magic));
+        header.tuples = TupleCount;
+        header.squares = TupleSquares;
+        std::random_device device;
+        header.origin = ((uint64_t)device() << 32) | device();
+        int newFd = ::open( path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        bool made = (newFd >= 0 && ftruncate( newFd, networkLength()) == 0
+                     && pwrite( newFd, &header, sizeof( header), 0) == (ssize_t)sizeof( header));
+        if( newFd >= 0) {
+            ::close( newFd);
+        }
+        if( !made) {
+            return false;
+        }
+    }
+
+    fd = ::open( path, writable ? O_RDWR : O_RDONLY);
+    if( fd < 0 || fstat( fd, &info) != 0 || (size_t)info.st_size != networkLength()) {
+        close();
+        return false;
+    }
+    length = networkLength();
+    void *pMap = mmap( NULL, length, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    if( pMap == MAP_FAILED) {
+        close();
+        return false;
+    }
+    pHeader = (NetworkHeader *)pMap;
+    pWeights = (float *)(pHeader + 1);
+    if( memcmp( pHeader->magic, NetworkMagic, sizeof( pHeader->magic)) != 0
+        || pHeader->tuples != TupleCount || pHeader->squares != TupleSquares) {
+        close();
+        return false;
+    }
+    madvise( pMap, length, MADV_RANDOM);
+    return true;
+}
+
+
+void NTupleNetwork::close()
+{
+    if( pHeader != NULL) {
+        munmap( pHeader, length);
+    }
+    if( fd >= 0) {
+        ::close( fd);
+    }
+    fd = -1;
+    length = 0;
+    pHeader = NULL;
+    pWeights = NULL;
+}
+
+
+// The weights are read and written as relaxed atomics: plain loads and stores on x86,
+// but defined behaviour when threads training at once touch the same weight
+float NTupleNetwork::evaluate( uint64_t key) const
+{
+    if( pWeights == NULL) {
+        return 0;
+    }
+    float value = 0;
+    for( int s=0; s<BoardSymmetries; s++) {
+        uint64_t turned = boardKey4Symmetry( key, s);
+        for( int t=0; t<TupleCount; t++) {
+            float weight;
+            __atomic_load( &pWeights[ (size_t)t * TupleEntries + tupleIndex( turned, Tuples[ t])], &weight, __ATOMIC_RELAXED);
+            value += weight;
+        }
+    }
+    return value;
+}
+
+
+void NTupleNetwork::update( uint64_t key, float delta)
+{
+    float step = delta / Lookups;
+    for( int s=0; s<BoardSymmetries; s++) {
+        uint64_t turned = boardKey4Symmetry( key, s);
+        for( int t=0; t<TupleCount; t++) {
+            float *pWeight = &pWeights[ (size_t)t * TupleEntries + tupleIndex( turned, Tuples[ t])];
+            float weight;
+            __atomic_load( pWeight, &weight, __ATOMIC_RELAXED);
+            weight += step;
+            __atomic_store( pWeight, &weight, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+
+long NTupleNetwork::gamesTrained() const
+{
+    return (pHeader != NULL) ? (long)__atomic_load_n( &pHeader->games, __ATOMIC_RELAXED) : 0;
+}
+
+
+uint64_t NTupleNetwork::identity() const
+{
+    if( pHeader == NULL) {
+        return 0;
+    }
+    // Mix the two, so that nearby game counts give unrelated identities
+    uint64_t x = pHeader->origin ^ (__atomic_load_n( &pHeader->games, __ATOMIC_RELAXED) * 0x9E3779B97F4A7C15ull);
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    x ^= x >> 31;
+    return x + (x == 0);
+}
+
+
+void NTupleNetwork::addGamesTrained( long games)
+{
+    __atomic_fetch_add( &pHeader->games, (uint64_t)games, __ATOMIC_RELAXED);
+}
+
+
+//--------------------------------------------------------------------
+// The move with the most points plus value of the board it leaves, which is copied to
+// after.  Returns false if no move changes the board.
+static bool bestMove( const NTupleNetwork &network, const BoardKernels &kernels, const int board[],
+                      int after[], char &direction, int &points, float &total)
+{
+    int squaresPerSide = kernels.squaresPerSide;
+    bool found = false;
+    for( int d=0; d<4; d++) {
+        int moved[ MaxBoardSize * MaxBoardSize];
+        int score = 0;
+        kernels.duplicate( moved, (int *)board);
+        if( !applyMove( kernels, moved, TrainOrder[ d], score).changed) {
+            continue;
+        }
+        float value = score + ((squaresPerSide == 4) ? network.evaluate( boardKey4( moved)) : 0);
+        if( !found || value > total) {
+            found = true;
+            direction = TrainOrder[ d];
+            points = score;
+            total = value;
+            kernels.duplicate( after, moved);
+        }
+    }
+    return found;
+}
+
+
+// Play one game, moving the value of each board left by a move toward the points and
+// value of the next move's board, or toward 0 once the game is over
+static GameResult trainGame( NTupleNetwork &network, float rate, GameRng &rng)
+{
+    const BoardKernels &kernels = boardKernels( 4);
+    int Tile = winningTile( 4);
+    int board[ 16] = { 0 };
+    Random1( board, 4, rng);
+    Random1( board, 4, rng);
+
+    GameResult result = { 0, 0, 0, false };
+    uint64_t previous = 0;
+    bool learning = false;   // previous holds the board left by the last move
+    GameStatus status;
+    while( (status = kernels.gameStatus( board, Tile)) == GameContinues) {
+        int after[ 16];
+        char direction;
+        int points;
+        float total;
+        bestMove( network, kernels, board, after, direction, points, total);
+        uint64_t key = boardKey4( after);
+        if( learning) {
+            network.update( previous, rate * (total - network.evaluate( previous)));
+        }
+        previous = key;
+        learning = true;
+        kernels.duplicate( board, after);
+        result.score += points;
+        result.moves++;
+        Random1( board, 4, rng);
+    }
+    if( learning) {
+        network.update( previous, rate * -network.evaluate( previous));
+    }
+    for( int i=0; i<16; i++) {
+        result.maxTile = std::max( result.maxTile, board[ i]);
+    }
+    result.won = (status == GameWon);
+    return result;
+}
+
+
+void trainNetwork( NTupleNetwork &network, const TrainOptions &options, std::ostream &out)
+{
+    ThreadPool pool( options.threads);
+    std::vector<GameResult> results;
+    out << std::fixed << std::setprecision( 1);
+    out << "Training on " << pool.size() << " threads, from " << network.gamesTrained() << " games\n";
+    out << std::setw( 10) << "games" << std::setw( 12) << "games/sec" << std::setw( 12) << "moves/sec"
+        << std::setw( 12) << "mean score" << std::setw( 8) << "won %" << std::endl;
+    for( long done=0; done<options.games; ) {
+        int chunk = (int)std::min( (long)options.reportEvery, options.games - done);
+        long first = network.gamesTrained();
+        results.assign( chunk, GameResult());
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        pool.parallelFor( chunk, [&]( int game) {
+            GameRng rng( options.seed, first + game);
+            results[ game] = trainGame( network, options.learningRate, rng);
+        });
+        double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start).count();
+        network.addGamesTrained( chunk);
+        done += chunk;
+
+        long moves = 0;
+        long points = 0;
+        int won = 0;
+        for( int g=0; g<chunk; g++) {
+            moves += results[ g].moves;
+            points += results[ g].score;
+            won += results[ g].won;
+        }
+        out << std::setw( 10) << network.gamesTrained() << std::setw( 12) << chunk / seconds
+            << std::setw( 12) << moves / seconds << std::setw( 12) << (double)points / chunk
+            << std::setw( 8) << 100.0 * won / chunk << std::endl;
+    }
+}
+
+
+//--------------------------------------------------------------------
+NTuplePolicy::NTuplePolicy( const NTupleNetwork &network)
+    : network( network), value( 0)
+{
+}
+
+
+// Moves are chosen on the points and values of the boards they leave, without chance
+char NTuplePolicy::chooseMove( const int board[], int squaresPerSide, GameRng & /*rng*/)
+{
+    int after[ MaxBoardSize * MaxBoardSize];
+    char direction = TrainOrder[ 0];
+    int points = 0;
+    float total = 0;
+    bestMove( network, boardKernels( squaresPerSide), board, after, direction, points, total);
+    value = total;
+    return direction;
+}
+
+
+static std::mutex networkLock;
+static NTupleNetwork sharedNetwork;   // the one every ntuple policy from createPolicy plays with
+static std::string networkPath;       // the file chosen, empty until one is
+
+
+// Open the weights at path as the policies' network, with networkLock held
+static void openPolicyNetwork( const char *path)
+{
+    networkPath = path;
+    if( !sharedNetwork.open( path, false)) {
+        std::cerr << "No n-tuple weights in " << path << "; the ntuple policy will play on points alone." << std::endl;
+    }
+}
+
+
+bool setPolicyWeights( const char *path)
+{
+    std::lock_guard<std::mutex> guard( networkLock);
+    if( !networkPath.empty()) {
+        return networkPath == path;
+    }
+    openPolicyNetwork( path);
+    return true;
+}
+
+
+const NTupleNetwork &policyNetwork()
+{
+    std::lock_guard<std::mutex> guard( networkLock);
+    if( networkPath.empty()) {
+        openPolicyNetwork( DefaultWeightsFile);
+    }
+    return sharedNetwork;
+}
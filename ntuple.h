@@ -0,0 +1,122 @@
+//
+// N-tuple network player for the 4x4 board, trained by temporal-difference learning.
+//
+// The network values a board as the sum of weights looked up in one table per tuple:
+// each tuple is a fixed set of six squares, and the exponents on those squares (4 bits
+// each, as in the packed board key) index its table.  Every tuple is also looked up on
+// the seven other rotations and reflections of the board, so what is learned in one
+// corner applies in all of them.
+//
+// Training plays games against itself with the same moves and Random1 pieces as the
+// rest of the program.  Each move is the one whose points plus the value of the board
+// it leaves (before the new piece) is highest, and the value of the previous such board
+// is moved toward that total (TD(0) on afterstates).  Games are spread over the pool's
+// threads, which all update the one set of weights without locks ("Hogwild"): two
+// threads rarely touch the same weight at once, and when they do one small step is
+// lost, which costs less than any lock would.
+//
+// The weights live in a file that is mapped into memory, so training resumes where it
+// left off, and players start at once however large the file is:
+//
+//   Header   "1024NT01", tuples (4), squares per tuple (4), games trained (8), a random
+//            number chosen when the file is made (8), padded to 64 bytes
+//   Weights  one float per exponent combination of each tuple, 16^6 per tuple
+//
+#ifndef NTUPLE_H
+#define NTUPLE_H
+
+#include <stdint.h>
+#include <iostream>
+#include "policy.h"
+
+
+const int TupleCount = 4;
+const int TupleSquares = 6;
+const int TupleEntries = 1 << (4 * TupleSquares);
+const char DefaultWeightsFile[] = "ntuple.weights";
+const float DefaultLearningRate = 0.1f;
+
+struct NetworkHeader;
+
+
+class NTupleNetwork
+{
+public:
+    NTupleNetwork();
+    ~NTupleNetwork();
+
+    // Map the weights file at path, creating it with every weight 0 if it does not
+    // exist and writable is set.  Returns false if it cannot be mapped or is not a
+    // weights file for these tuples.
+    bool open( const char *path, bool writable);
+    void close();
+    bool isOpen() const { return pWeights != NULL; }
+
+    // Value of a 4x4 board held as a packed key (see boardkey.h), 0 if nothing is open
+    float evaluate( uint64_t key) const;
+
+    // Move the value of a board by delta, shared out over all the weights it uses.
+    // Safe to call from many threads at once, as described above.
+    void update( uint64_t key, float delta);
+
+    long gamesTrained() const;
+    void addGamesTrained( long games);
+
+    // Names these weights: the file they came from and the games trained into them,
+    // so that moves chosen with other weights can be told apart.  0 if nothing is open.
+    uint64_t identity() const;
+
+private:
+    int fd;
+    size_t length;
+    NetworkHeader *pHeader;
+    float *pWeights;
+
+    NTupleNetwork( const NTupleNetwork &);              // not copyable
+    NTupleNetwork &operator=( const NTupleNetwork &);
+};
+
+
+struct TrainOptions
+{
+    long games;
+    int threads;            // 0 for one per core
+    float learningRate;     // step toward each target, before it is shared over the weights
+    unsigned seed;
+    int reportEvery;        // games between progress lines
+};
+
+
+// Play options.games games against itself on the 4x4 board, learning from each, and
+// print the games/sec, moves/sec, mean score and win rate of every options.reportEvery
+// games to out
+void trainNetwork( NTupleNetwork &network, const TrainOptions &options, std::ostream &out);
+
+
+// Chooses the move with the most points plus value of the board it leaves.  Boards
+// other than 4x4, or a network with no weights open, are played on points alone.
+class NTuplePolicy : public MovePolicy
+{
+public:
+    explicit NTuplePolicy( const NTupleNetwork &network);
+
+    char chooseMove( const int board[], int squaresPerSide, GameRng &rng);
+    double moveValue() const { return value; }
+
+private:
+    const NTupleNetwork &network;
+    double value;
+};
+
+
+// Choose the weights file the ntuple policy from createPolicy plays with, and open it
+// for reading.  The policies hold on to the network, so it is chosen once: returns false,
+// changing nothing, if another file has already been chosen, or DefaultWeightsFile has
+// been opened by policyNetwork().
+bool setPolicyWeights( const char *path);
+
+// The network the ntuple policy plays with, opening DefaultWeightsFile if no file has
+// been chosen
+const NTupleNetwork &policyNetwork();
+
+#endif
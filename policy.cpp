@@ -0,0 +1,117 @@
+//
+// Move policies.  See policy.h.
+//
+#include "policy.h"
+#include "game.h"
+#include "boardkernels.h"
+#include "expectimax.h"
+#include "montecarlo.h"
+#include "ntuple.h"
+
+
+const char MoveOrder[] = { 's', 'a', 'd', 'w' };   // down and left first, keeping big tiles in a corner
+
+
+// Try a move on a copy of the board.  Returns true if it changed the board.
+static bool tryMove( const int board[], int squaresPerSide, char direction, int &score)
+{
+    const BoardKernels &kernels = boardKernels( squaresPerSide);
+    int copy[ MaxBoardSize * MaxBoardSize];
+    kernels.duplicate( copy, (int *)board);
+    return applyMove( kernels, copy, direction, score).changed;
+}
+
+
+//--------------------------------------------------------------------
+// Any direction, uniformly at random
+class RandomPolicy : public MovePolicy
+{
+public:
+    char chooseMove( const int /*board*/[], int /*squaresPerSide*/, GameRng &rng)
+    {
+        return MoveOrder[ rng.below( 4)];
+    }
+};
+
+
+// The first direction in MoveOrder that changes the board
+class CornerPolicy : public MovePolicy
+{
+public:
+    char chooseMove( const int board[], int squaresPerSide, GameRng & /*rng*/)
+    {
+        int legal = boardKernels( squaresPerSide).legalMoves( board);
+        for( int d=0; d<4; d++) {
+            if( legal & directionBit( MoveOrder[ d])) {
+                return MoveOrder[ d];
+            }
+        }
+        return MoveOrder[ 0];
+    }
+};
+
+
+// The direction that scores the most on this move, ties going to the earlier one in MoveOrder
+class GreedyPolicy : public MovePolicy
+{
+public:
+    char chooseMove( const int board[], int squaresPerSide, GameRng & /*rng*/)
+    {
+        char best = MoveOrder[ 0];
+        int bestScore = -1;
+        for( int d=0; d<4; d++) {
+            int score = 0;
+            if( tryMove( board, squaresPerSide, MoveOrder[ d], score) && score > bestScore) {
+                best = MoveOrder[ d];
+                bestScore = score;
+            }
+        }
+        return best;
+    }
+};
+
+
+//--------------------------------------------------------------------
+MovePolicy *createPolicy( const std::string &name, ThreadPool *pPool, double budgetMs)
+{
+    if( name == "random") {
+        return new RandomPolicy;
+    }
+    if( name == "corner") {
+        return new CornerPolicy;
+    }
+    if( name == "greedy") {
+        return new GreedyPolicy;
+    }
+    if( name == "expectimax") {
+        return new ExpectimaxPolicy( pPool);
+    }
+    if( name == "montecarlo") {
+        return new MonteCarloPolicy( pPool, budgetMs > 0 ? budgetMs : DefaultRolloutMs);
+    }
+    if( name == "ntuple") {
+        return new NTuplePolicy( policyNetwork());
+    }
+    return NULL;
+}
+
+
+const char *policyNames()
+{
+    return "random corner greedy expectimax montecarlo ntuple";
+}
+
+
+bool policyIsDeterministic( const std::string &name)
+{
+    return name == "corner" || name == "greedy" || name == "expectimax" || name == "ntuple";
+}
+
+
+bool policyIsSymmetric( const std::string &name)
+{
+    // None so far: corner prefers fixed directions, and the others break ties between
+    // equally good moves in a fixed direction order, which a turned board reorders
+    (void)name;
+    return false;
+}
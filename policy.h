@@ -0,0 +1,62 @@
+//
+// Move policies: pluggable ways of choosing the next move, used by the headless
+// batch runner and anything else that plays games without a person at the keyboard.
+//
+#ifndef POLICY_H
+#define POLICY_H
+
+#include <string>
+#include "rng.h"
+
+class ThreadPool;
+
+
+// Counters kept by the policies that search
+struct SearchStats
+{
+    long nodes;       // positions evaluated or expanded
+    long lookups;     // transposition table probes
+    long hits;        // probes that found a usable entry
+    long playouts;    // games played to the end by rollout policies
+    double seconds;   // time spent choosing moves
+
+    SearchStats() : nodes( 0), lookups( 0), hits( 0), playouts( 0), seconds( 0) {}
+};
+
+
+class MovePolicy
+{
+public:
+    virtual ~MovePolicy() {}
+
+    // Choose 'w', 'a', 's' or 'd' for the board.  If the chosen direction does not
+    // change the board, the caller tries the other directions in turn.
+    virtual char chooseMove( const int board[], int squaresPerSide, GameRng &rng) = 0;
+
+    // Add this policy's counters to totals; policies that do not search add nothing
+    virtual void addStats( SearchStats & /*totals*/) const {}
+
+    // What the most recent chooseMove expected from its move, in the policy's own
+    // units; policies that do not evaluate moves return 0
+    virtual double moveValue() const { return 0; }
+};
+
+
+// Create a policy by name, or return NULL if there is no such policy.  Each thread
+// playing games creates its own instance.  Searching policies spread their work
+// over pPool when one is given.  Policies that stop on time spend budgetMs on each
+// move, or their own default if it is 0.
+MovePolicy *createPolicy( const std::string &name, ThreadPool *pPool = NULL, double budgetMs = 0);
+
+// Names accepted by createPolicy, separated by spaces
+const char *policyNames();
+
+// True for a policy whose move depends on the board alone, not on the random
+// generator or the time taken, so that its moves can be kept and given again
+bool policyIsDeterministic( const std::string &name);
+
+// True for a policy that makes the same move, turned to match, on every rotation and
+// reflection of a board, so that all of them can share one cached answer
+bool policyIsSymmetric( const std::string &name);
+
+#endif
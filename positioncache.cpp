@@ -0,0 +1,309 @@
+//
+// Persistent cache of the moves chosen for opening positions.  See positioncache.h.
+//
+#include "positioncache.h"
+#include <cstdio>            // For rename(), remove()
+#include <algorithm>         // For min()
+#include <cstring>           // For memcmp(), memcpy(), memset()
+#include <fcntl.h>           // For open()
+#include <sys/mman.h>        // For mmap()
+#include <sys/stat.h>        // For fstat()
+#include <unistd.h>          // For close(), ftruncate()
+#include "game.h"
+#include "boardkey.h"
+
+
+const char CacheMagic[] = "1024PC03";
+const int CacheMagicBytes = 8;
+const int PolicyNameBytes = 16;
+const int MaxProbes = 32;           // slots looked at before giving up on a position
+
+
+struct CacheHeader
+{
+    char magic[ CacheMagicBytes];
+    uint32_t slotBits;
+    uint32_t symmetric;  // 1 if rotations and reflections of a board share one entry
+    uint64_t entries;
+    char policy[ PolicyNameBytes];
+    double budgetMs;
+    uint64_t weights;
+    char padding[ 8];
+};
+
+struct CacheSlot
+{
+    uint64_t key;        // first hash of the position, 0 for an empty slot
+    uint64_t check;      // second hash, so that two positions almost never share a slot
+    float value;
+    char move;           // for the position as keyed, turned to its canonical symmetry if symmetric
+    unsigned char squaresPerSide;
+    unsigned char padding[ 2];
+};
+
+
+//--------------------------------------------------------------------
+static int countTiles( const int board[], int squaresPerSide)
+{
+    int tiles = 0;
+    for( int i=0; i<squaresPerSide * squaresPerSide; i++) {
+        tiles += (board[ i] != 0);
+    }
+    return tiles;
+}
+
+
+// The slot holding key, or the empty slot where it would go, or NULL if neither is
+// found within MaxProbes slots
+static CacheSlot *findSlot( CacheSlot *pSlots, long mask, uint64_t key, uint64_t check)
+{
+    for( int probe=0; probe<MaxProbes; probe++) {
+        CacheSlot &slot = pSlots[ (key + probe) & mask];
+        uint64_t found = __atomic_load_n( &slot.key, __ATOMIC_ACQUIRE);
+        if( found == 0 || (found == key && slot.check == check)) {
+            return &slot;
+        }
+    }
+    return NULL;
+}
+
+
+// The header naming the policy whose moves a cache holds, with its name cut to fit
+// and padded with zeros
+static void describePolicy( CacheHeader &header, const std::string &policy, double budgetMs, uint64_t weights)
+{
+    memset( header.policy, 0, PolicyNameBytes);
+    memcpy( header.policy, policy.c_str(), std::min( policy.size(), (size_t)PolicyNameBytes - 1));
+    header.budgetMs = budgetMs;
+    header.weights = weights;
+    header.symmetric = policyIsSymmetric( policy) ? 1 : 0;
+}
+
+
+static size_t fileLength( int slotBits)
+{
+    return sizeof( CacheHeader) + ((size_t)1 << slotBits) * sizeof( CacheSlot);
+}
+
+
+// Write an empty cache file with 2^slotBits slots for the policy described in owner,
+// holding the entries of pOld if it is not NULL.  Returns false if the file cannot be
+// written.
+static bool writeCacheFile( const char *path, int slotBits, const CacheHeader &owner,
+                            const CacheHeader *pOld, const CacheSlot *pOldSlots)
+{
+    int fd = ::open( path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if( fd < 0) {
+        return false;
+    }
+    size_t length = fileLength( slotBits);
+    if( ftruncate( fd, length) != 0) {
+        ::close( fd);
+        return false;
+    }
+    void *pMap = mmap( NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close( fd);
+    if( pMap == MAP_FAILED) {
+        return false;
+    }
+    CacheHeader *pHeader = (CacheHeader *)pMap;
+    CacheSlot *pSlots = (CacheSlot *)(pHeader + 1);
+    memcpy( pHeader->magic, CacheMagic, CacheMagicBytes);
+    pHeader->slotBits = slotBits;
+    memcpy( pHeader->policy, owner.policy, PolicyNameBytes);
+    pHeader->budgetMs = owner.budgetMs;
+    pHeader->weights = owner.weights;
+    pHeader->symmetric = owner.symmetric;
+    if( pOld != NULL) {
+        long mask = ((long)1 << slotBits) - 1;
+        for( long i=0; i<((long)1 << pOld->slotBits); i++) {
+            const CacheSlot &old = pOldSlots[ i];
+            CacheSlot *pSlot = (old.key != 0) ? findSlot( pSlots, mask, old.key, old.check) : NULL;
+            if( pSlot != NULL && pSlot->key == 0) {
+                *pSlot = old;
+                pHeader->entries++;
+            }
+        }
+    }
+    munmap( pMap, length);
+    return true;
+}
+
+
+//--------------------------------------------------------------------
+PositionCache::PositionCache()
+    : fd( -1), length( 0), pHeader( NULL), pSlots( NULL), mask( 0), symmetric( false), lookupCount( 0), hitCount( 0)
+{
+}
+
+
+PositionCache::~PositionCache()
+{
+    close();
+}
+
+
+bool PositionCache::open( const char *path, const std::string &policy, double budgetMs, uint64_t weights)
+{
+    close();
+    if( !policyIsDeterministic( policy)) {
+        return false;
+    }
+    CacheHeader wanted;
+    describePolicy( wanted, policy, budgetMs, weights);
+
+    struct stat info;
+    if( stat( path, &info) != 0 && !writeCacheFile( path, DefaultCacheBits, wanted, NULL, NULL)) {
+        return false;
+    }
+    fd = ::open( path, O_RDWR);
+    if( fd < 0 || fstat( fd, &info) != 0 || info.st_size < (off_t)sizeof( CacheHeader)) {
+        close();
+        return false;
+    }
+    length = (size_t)info.st_size;
+    void *pMap = mmap( NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if( pMap == MAP_FAILED) {
+        close();
+        return false;
+    }
+    pHeader = (CacheHeader *)pMap;
+    pSlots = (CacheSlot *)(pHeader + 1);
+    if( memcmp( pHeader->magic, CacheMagic, CacheMagicBytes) != 0 || pHeader->slotBits > 40
+        || length != fileLength( pHeader->slotBits) || memcmp( pHeader->policy, wanted.policy, PolicyNameBytes) != 0
+        || pHeader->budgetMs != wanted.budgetMs || pHeader->weights != wanted.weights
+        || pHeader->symmetric != wanted.symmetric) {
+        close();
+        return false;
+    }
+    mask = ((long)1 << pHeader->slotBits) - 1;
+    symmetric = (pHeader->symmetric != 0);
+
+    // Give a table over half full twice the room, so probes stay short as it fills
+    if( (long)pHeader->entries * 2 > mask + 1) {
+        std::string grown = std::string( path) + ".grow";
+        if( !writeCacheFile( grown.c_str(), pHeader->slotBits + 1, wanted, pHeader, pSlots)
+            || rename( grown.c_str(), path) != 0) {
+            remove( grown.c_str());
+            close();
+            return false;
+        }
+        return open( path, policy, budgetMs, weights);
+    }
+    madvise( pMap, length, MADV_RANDOM);
+    return true;
+}
+
+
+void PositionCache::close()
+{
+    if( pHeader != NULL) {
+        munmap( pHeader, length);
+    }
+    if( fd >= 0) {
+        ::close( fd);
+    }
+    fd = -1;
+    length = 0;
+    pHeader = NULL;
+    pSlots = NULL;
+    mask = 0;
+}
+
+
+long PositionCache::entries() const
+{
+    return (pHeader != NULL) ? (long)__atomic_load_n( &pHeader->entries, __ATOMIC_RELAXED) : 0;
+}
+
+
+// The two hashes a board is kept under: of its canonical form if turned boards share
+// entries, returning the symmetry that turns the board to it, or else of the board as
+// it is, returning 0
+int PositionCache::positionKey( const int board[], int squaresPerSide, uint64_t &key, uint64_t &check) const
+{
+    BoardKey position, canonical;
+    boardKeyFromArray( position, board, squaresPerSide);
+    int s = symmetric ? canonicalBoardKey( position, canonical) : 0;
+    const BoardKey &kept = symmetric ? canonical : position;
+    key = boardKeyHash( kept, 1);
+    check = boardKeyHash( kept, 2);
+    key += (key == 0);
+    return s;
+}
+
+
+bool PositionCache::lookup( const int board[], int squaresPerSide, char &move, float &value)
+{
+    if( pSlots == NULL || countTiles( board, squaresPerSide) > CacheMaxTiles) {
+        return false;
+    }
+    lookupCount++;
+    uint64_t key, check;
+    int s = positionKey( board, squaresPerSide, key, check);
+    CacheSlot *pSlot = findSlot( pSlots, mask, key, check);
+    if( pSlot == NULL || __atomic_load_n( &pSlot->key, __ATOMIC_ACQUIRE) != key) {
+        return false;
+    }
+    move = symmetric ? symmetricDirection( pSlot->move, s, true) : pSlot->move;
+    value = pSlot->value;
+    hitCount++;
+    return true;
+}
+
+
+void PositionCache::store( const int board[], int squaresPerSide, char move, float value)
+{
+    if( pSlots == NULL || countTiles( board, squaresPerSide) > CacheMaxTiles) {
+        return;
+    }
+    uint64_t key, check;
+    int s = positionKey( board, squaresPerSide, key, check);
+
+    // Fill in the slot before publishing its key, so lookups never see half an entry
+    std::lock_guard<std::mutex> hold( storeLock);
+    CacheSlot *pSlot = findSlot( pSlots, mask, key, check);
+    if( pSlot == NULL || pSlot->key != 0 || (long)pHeader->entries * 4 >= (mask + 1) * 3) {
+        return;
+    }
+    pSlot->check = check;
+    pSlot->value = value;
+    pSlot->move = symmetric ? symmetricDirection( move, s, false) : move;
+    pSlot->squaresPerSide = (unsigned char)squaresPerSide;
+    __atomic_store_n( &pSlot->key, key, __ATOMIC_RELEASE);
+    __atomic_fetch_add( &pHeader->entries, 1, __ATOMIC_RELAXED);
+}
+
+
+//--------------------------------------------------------------------
+CachedPolicy::CachedPolicy( MovePolicy *pInner, PositionCache &cache)
+    : pInner( pInner), cache( cache), value( 0)
+{
+}
+
+
+CachedPolicy::~CachedPolicy()
+{
+    delete pInner;
+}
+
+
+char CachedPolicy::chooseMove( const int board[], int squaresPerSide, GameRng &rng)
+{
+    char move;
+    float cached;
+    if( cache.lookup( board, squaresPerSide, move, cached)) {
+        value = cached;
+        return move;
+    }
+    move = pInner->chooseMove( board, squaresPerSide, rng);
+    value = pInner->moveValue();
+    cache.store( board, squaresPerSide, move, (float)value);
+    return move;
+}
+
+
+void CachedPolicy::addStats( SearchStats &totals) const
+{
+    pInner->addStats( totals);
+}
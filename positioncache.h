@@ -0,0 +1,105 @@
+//
+// Persistent cache of the moves chosen for opening positions.
+//
+// Games start from a small number of boards, so the searching players keep working out
+// the same first moves.  A PositionCache keeps the move a player chose, and the value
+// it expected from it, for each position with few tiles, in a file that is mapped into
+// memory: opening it costs nothing however large it is, lookups read the mapping
+// directly, and new positions are written into it as games are played, so the next
+// run starts warm.  Only the moves of deterministic policies are kept, since a policy
+// that draws on the random generator or the clock could choose differently the next
+// time.  Rotations and reflections of a board share one entry only for a policy that
+// policyIsSymmetric() lists; any other would not choose the turned move on a turned
+// board, so each position is kept as it is.
+//
+//   Header   "1024PC03", slot count as a power of two (4), 1 if turned boards share
+//            entries (4), entries (8), the name of the policy that chose the moves
+//            (16), its time per move (8) and the identity of its weights (8), padded
+//            to 64 bytes
+//   Slots    open-addressed hash table of 24-byte entries: two 64-bit hashes of the
+//            position, the value (float), the move and the board size
+//
+#ifndef POSITIONCACHE_H
+#define POSITIONCACHE_H
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include "policy.h"
+
+
+const int CacheMaxTiles = 6;          // positions with more tiles than this are not kept
+const int DefaultCacheBits = 18;      // slots in a new cache file, as a power of two
+
+
+struct CacheHeader;
+struct CacheSlot;
+
+
+class PositionCache
+{
+public:
+    PositionCache();
+    ~PositionCache();
+
+    // Map the cache file at path, creating it if it does not exist, and doubling its
+    // table first if it is over half full.  The policy is named as for createPolicy,
+    // with the budgetMs it was given and the identity of its weights, 0 for a policy
+    // without any.  Returns false if the policy is not deterministic, or if the file
+    // cannot be created or mapped or holds moves chosen by another policy, budget or
+    // set of weights.
+    bool open( const char *path, const std::string &policy, double budgetMs = 0, uint64_t weights = 0);
+    void close();
+
+    // True if the board, or a rotation or reflection of it, is in the cache, giving the
+    // move turned to match this board and the value stored with it.  Safe to call from
+    // any number of threads while others store.
+    bool lookup( const int board[], int squaresPerSide, char &move, float &value);
+
+    // Keep the move chosen for a board, unless it has too many tiles, is already there,
+    // or the table is too full
+    void store( const int board[], int squaresPerSide, char move, float value);
+
+    long entries() const;
+    long slots() const { return mask + 1; }
+    long lookups() const { return lookupCount.load(); }
+    long hits() const { return hitCount.load(); }
+
+private:
+    int fd;
+    size_t length;
+    CacheHeader *pHeader;
+    CacheSlot *pSlots;
+    long mask;
+    bool symmetric;                // rotations and reflections share entries
+    std::mutex storeLock;          // one thread stores at a time; lookups take no lock
+    std::atomic<long> lookupCount;
+    std::atomic<long> hitCount;
+
+    int positionKey( const int board[], int squaresPerSide, uint64_t &key, uint64_t &check) const;
+
+    PositionCache( const PositionCache &);              // not copyable
+    PositionCache &operator=( const PositionCache &);
+};
+
+
+// A policy that answers from the cache when it can, and otherwise asks the policy it
+// wraps and stores the answer.  It deletes the wrapped policy when it is deleted.
+class CachedPolicy : public MovePolicy
+{
+public:
+    CachedPolicy( MovePolicy *pInner, PositionCache &cache);
+    ~CachedPolicy();
+
+    char chooseMove( const int board[], int squaresPerSide, GameRng &rng);
+    void addStats( SearchStats &totals) const;
+    double moveValue() const { return value; }
+
+private:
+    MovePolicy *pInner;
+    PositionCache &cache;
+    double value;
+};
+
+#endif
@@ -0,0 +1,237 @@
+//
+// Lightweight phase timers and counters for 1024.  See profile.h.
+//
+#include "profile.h"
+#include <atomic>            // For atomic, the lock-free histograms and counters
+#include <cstdio>            // For snprintf
+#include <cstdlib>           // For malloc(), free()
+#include <fstream>           // For ofstream, the periodic log
+#include <new>               // For bad_alloc, in the counting operator new
+using namespace std;
+
+
+struct TimerHistogram
+{
+    atomic<uint64_t> buckets[ HistogramBuckets];
+    atomic<uint64_t> count;
+    atomic<uint64_t> totalNs;
+    atomic<uint64_t> maxNs;
+};
+
+// Zero-initialized, as statics are, so recording can start before main()
+static TimerHistogram histograms[ ProfileTimers];
+static atomic<uint64_t> counters[ ProfileCounters];
+
+static const char *timerNames[ ProfileTimers] = {
+    "events", "idle", "move", "spawn", "status", "history",
+    "record", "search", "draw", "present", "console"
+};
+
+
+#ifndef NO_PROFILING
+// Count every allocation made by the program, for allocations per move.  The arrays
+// and plain new go through here; delete is unchanged apart from matching it.
+void *operator new( size_t size)
+{
+    counters[ CounterAllocations].fetch_add( 1, memory_order_relaxed);
+    void *p = malloc( size > 0 ? size : 1);
+    if( p == NULL) {
+        throw bad_alloc();
+    }
+    return p;
+}
+
+void operator delete( void *p) noexcept
+{
+    free( p);
+}
+#endif
+
+
+//--------------------------------------------------------------------
+void profileRecord( ProfileTimer timer, uint64_t ns)
+{
+    TimerHistogram &histogram = histograms[ timer];
+    int bucket = (ns == 0) ? 0 : 64 - __builtin_clzll( ns);
+    if( bucket >= HistogramBuckets) {
+        bucket = HistogramBuckets - 1;
+    }
+    histogram.buckets[ bucket].fetch_add( 1, memory_order_relaxed);
+    histogram.count.fetch_add( 1, memory_order_relaxed);
+    histogram.totalNs.fetch_add( ns, memory_order_relaxed);
+    uint64_t largest = histogram.maxNs.load( memory_order_relaxed);
+    while( ns > largest && !histogram.maxNs.compare_exchange_weak( largest, ns, memory_order_relaxed)) {
+    }
+}
+
+
+void profileCount( ProfileCounter counter, uint64_t n)
+{
+    counters[ counter].fetch_add( n, memory_order_relaxed);
+}
+
+
+uint64_t profileCounter( ProfileCounter counter)
+{
+    return counters[ counter].load( memory_order_relaxed);
+}
+
+
+const char *profileTimerName( ProfileTimer timer)
+{
+    return timerNames[ timer];
+}
+
+
+// The upper edge of the bucket holding the given fraction of the times, or the
+// longest time if that is less
+static double percentile( const TimerHistogram &histogram, uint64_t count, uint64_t maxNs, double fraction)
+{
+    uint64_t wanted = (uint64_t)(fraction * count);
+    uint64_t seen = 0;
+    int b = 0;
+    while( b < HistogramBuckets - 1) {
+        seen += histogram.buckets[ b].load( memory_order_relaxed);
+        if( seen > wanted) {
+            break;
+        }
+        b++;
+    }
+    uint64_t edge = 1ull << b;
+    return (double)((edge < maxNs) ? edge : maxNs);
+}
+
+
+TimerSummary profileSummary( ProfileTimer timer)
+{
+    const TimerHistogram &histogram = histograms[ timer];
+    TimerSummary summary;
+    summary.count = histogram.count.load( memory_order_relaxed);
+    summary.maxNs = histogram.maxNs.load( memory_order_relaxed);
+    uint64_t total = histogram.totalNs.load( memory_order_relaxed);
+    summary.meanNs = (summary.count > 0) ? (double)total / summary.count : 0;
+    summary.p50Ns = (summary.count > 0) ? percentile( histogram, summary.count, summary.maxNs, 0.5) : 0;
+    summary.p99Ns = (summary.count > 0) ? percentile( histogram, summary.count, summary.maxNs, 0.99) : 0;
+    return summary;
+}
+
+
+ProfileSnapshot profileSnapshot()
+{
+    ProfileSnapshot snapshot;
+    snapshot.time = chrono::steady_clock::now();
+    for( int c=0; c<ProfileCounters; c++) {
+        snapshot.counters[ c] = counters[ c].load( memory_order_relaxed);
+    }
+    return snapshot;
+}
+
+
+// Moves/sec, allocations per move and draw calls per frame between last and now
+static void rates( const ProfileSnapshot &last, const ProfileSnapshot &now,
+                   double &movesPerSecond, double &allocationsPerMove, double &drawsPerFrame)
+{
+    double seconds = chrono::duration<double>( now.time - last.time).count();
+    uint64_t moves = now.counters[ CounterMoves] - last.counters[ CounterMoves];
+    uint64_t frames = now.counters[ CounterFrames] - last.counters[ CounterFrames];
+    movesPerSecond = (seconds > 0) ? moves / seconds : 0;
+    allocationsPerMove = (moves > 0) ? (double)(now.counters[ CounterAllocations] - last.counters[ CounterAllocations]) / moves : 0;
+    drawsPerFrame = (frames > 0) ? (double)(now.counters[ CounterDrawCalls] - last.counters[ CounterDrawCalls]) / frames : 0;
+}
+
+
+//--------------------------------------------------------------------
+string profileOverlay( ProfileSnapshot &last)
+{
+#ifdef NO_PROFILING
+    (void)last;
+    return "profiling compiled out";
+#else
+    string text = "mean/p99 us\n";
+    char line[ 80];
+    for( int t=0; t<ProfileTimers; t++) {
+        TimerSummary summary = profileSummary( (ProfileTimer)t);
+        snprintf( line, sizeof( line), "%-8s%8.1f%8.1f\n", timerNames[ t],
+                  summary.meanNs / 1000, summary.p99Ns / 1000);
+        text += line;
+    }
+    ProfileSnapshot now = profileSnapshot();
+    double movesPerSecond, allocationsPerMove, drawsPerFrame;
+    rates( last, now, movesPerSecond, allocationsPerMove, drawsPerFrame);
+    snprintf( line, sizeof( line), "%.1f moves/s\n%.1f allocs/move\n%.1f draws/frame",
+              movesPerSecond, allocationsPerMove, drawsPerFrame);
+    text += line;
+    last = now;
+    return text;
+#endif
+}
+
+
+void profileReport( ostream &out, ProfileSnapshot &last)
+{
+#ifdef NO_PROFILING
+    (void)last;
+    out << "Profiling was compiled out with NO_PROFILING." << endl;
+#else
+    char line[ 120];
+    snprintf( line, sizeof( line), "%-10s %10s %12s %12s %12s %12s", "phase", "count", "mean us", "p50 us", "p99 us", "max us");
+    out << line << "\n";
+    for( int t=0; t<ProfileTimers; t++) {
+        TimerSummary summary = profileSummary( (ProfileTimer)t);
+        snprintf( line, sizeof( line), "%-10s %10llu %12.2f %12.2f %12.2f %12.2f", timerNames[ t],
+                  (unsigned long long)summary.count, summary.meanNs / 1000, summary.p50Ns / 1000,
+                  summary.p99Ns / 1000, summary.maxNs / 1000.0);
+        out << line << "\n";
+    }
+    ProfileSnapshot now = profileSnapshot();
+    double movesPerSecond, allocationsPerMove, drawsPerFrame;
+    rates( last, now, movesPerSecond, allocationsPerMove, drawsPerFrame);
+    out << "moves " << now.counters[ CounterMoves] << ", frames " << now.counters[ CounterFrames]
+        << ", draw calls " << now.counters[ CounterDrawCalls]
+        << ", allocations " << now.counters[ CounterAllocations] << "\n"
+        << "since last report: " << movesPerSecond << " moves/sec, " << allocationsPerMove
+        << " allocations/move, " << drawsPerFrame << " draw calls/frame" << endl;
+    last = now;
+#endif
+}
+
+
+//--------------------------------------------------------------------
+static ofstream profileLog;
+static double logEvery = 0;
+static ProfileSnapshot logLast;
+static chrono::steady_clock::time_point logStart;
+
+
+bool profileLogOpen( const char *path, double everySeconds)
+{
+    profileLog.open( path);
+    if( !profileLog) {
+        return false;
+    }
+    logEvery = everySeconds;
+    logLast = profileSnapshot();
+    logStart = logLast.time;
+    return true;
+}
+
+
+void profileLogTick()
+{
+    if( !profileLog.is_open()
+        || chrono::duration<double>( chrono::steady_clock::now() - logLast.time).count() < logEvery) {
+        return;
+    }
+    profileLog << "--- " << chrono::duration<double>( chrono::steady_clock::now() - logStart).count() << " s\n";
+    profileReport( profileLog, logLast);
+}
+
+
+void profileLogClose()
+{
+    if( profileLog.is_open()) {
+        logEvery = 0;   // a last report, however recent the one before
+        profileLogTick();
+        profileLog.close();
+    }
+}
@@ -0,0 +1,119 @@
+//
+// Lightweight phase timers and counters for 1024.
+//
+// PROFILE_SCOPE( TimerDraw) at the top of a block adds the time until the end of the
+// block to that timer's histogram, and PROFILE_COUNT( CounterMoves, 1) adds to a
+// counter.  Histograms and counters are atomics updated with relaxed adds, so any
+// thread can record without taking a lock.  Building with -DNO_PROFILING turns both
+// macros into nothing; the reports are still there, saying so.
+//
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+
+// The phases of the main loop, and the engine functions it calls
+enum ProfileTimer
+{
+    TimerEvents,        // polling the window for keys
+    TimerIdle,          // waiting for a key typed in the terminal
+    TimerMove,          // sliding the board
+    TimerSpawn,         // Random1
+    TimerGameStatus,    // end of game check
+    TimerHistory,       // keeping the board for undo, and undoing
+    TimerRecord,        // adding to the game record
+    TimerSearch,        // the computer choosing a move
+    TimerDraw,          // bringing the vertex arrays up to date and drawing them
+    TimerPresent,       // window.display(), including the frame limit's wait
+    TimerConsole,       // printing the board and prompt in the terminal
+    ProfileTimers
+};
+
+enum ProfileCounter
+{
+    CounterMoves,          // moves that changed the board
+    CounterFrames,         // frames drawn
+    CounterDrawCalls,      // draw calls over all frames
+    CounterAllocations,    // calls to operator new, from any thread
+    ProfileCounters
+};
+
+const int HistogramBuckets = 40;   // bucket b holds times from 2^(b-1) up to 2^b nanoseconds
+
+
+// Summary of one timer's histogram, in nanoseconds
+struct TimerSummary
+{
+    uint64_t count;
+    double meanNs;
+    double p50Ns;       // upper edge of the bucket holding the median, so within a factor of 2
+    double p99Ns;
+    uint64_t maxNs;
+};
+
+// Counter values at one moment, so rates can be taken between two of them
+struct ProfileSnapshot
+{
+    std::chrono::steady_clock::time_point time;
+    uint64_t counters[ ProfileCounters];
+};
+
+
+void profileRecord( ProfileTimer timer, uint64_t ns);
+void profileCount( ProfileCounter counter, uint64_t n);
+uint64_t profileCounter( ProfileCounter counter);
+TimerSummary profileSummary( ProfileTimer timer);
+const char *profileTimerName( ProfileTimer timer);
+ProfileSnapshot profileSnapshot();
+
+// A few short lines for the overlay: the mean and 99th percentile of each phase, then
+// moves/sec, allocations per move and draw calls per frame since last, which is updated
+std::string profileOverlay( ProfileSnapshot &last);
+
+// Every timer and counter, as a block of text, with rates since last, which is updated
+void profileReport( std::ostream &out, ProfileSnapshot &last);
+
+// Write profileReport to path every everySeconds, called from the main loop as often as
+// it likes.  profileLogOpen returns false if the file cannot be created.
+bool profileLogOpen( const char *path, double everySeconds);
+void profileLogTick();
+void profileLogClose();
+
+
+// Times the block it is declared in
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer( ProfileTimer timer)
+        : timer( timer), start( std::chrono::steady_clock::now())
+    {
+    }
+
+    ~ScopedTimer()
+    {
+        std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start;
+        profileRecord( timer, std::chrono::duration_cast<std::chrono::nanoseconds>( elapsed).count());
+    }
+
+private:
+    ProfileTimer timer;
+    std::chrono::steady_clock::time_point start;
+};
+
+
+#define PROFILE_JOIN2( a, b) a##b
+#define PROFILE_JOIN( a, b) PROFILE_JOIN2( a, b)
+
+#ifndef NO_PROFILING
+#define PROFILE_SCOPE( timer) ScopedTimer PROFILE_JOIN( profileTimer, __LINE__)( timer)
+#define PROFILE_COUNT( counter, n) profileCount( counter, n)
+#else
+#define PROFILE_SCOPE( timer)
+#define PROFILE_COUNT( counter, n)
+#endif
+
+#endif
@@ -0,0 +1,391 @@
+//
+// Binary game records for 1024.  See record.h.
+//
+#include "record.h"
+#include <chrono>            // For steady_clock
+#include <cstring>           // For memcmp()
+#include <string>
+#include <fcntl.h>           // For open()
+#include <sys/mman.h>        // For mmap()
+#include <sys/stat.h>        // For fstat()
+#include <unistd.h>          // For close()
+#include "game.h"
+#include "boardkernels.h"
+#include "history.h"
+
+
+const char FileMagic[] = "1024REC1";
+const int MagicBytes = 8;
+const int WriteBufferBytes = 1 << 20;   // written to the file a megabyte at a time
+
+const char Directions[] = { 'w', 'a', 's', 'd' };
+
+// Event kinds, in the high four bits of each event byte
+const int EventMove = 0x00;
+const int EventPlace = 0x10;
+const int EventUndo = 0x20;
+const int EventRedo = 0x30;
+const int EventEnd = 0xF0;
+const int EventFour = 0x04;             // set on a move that placed a 4
+const int MaxExponent = 30;             // largest tile exponent an int board can hold
+
+
+// Tiles are powers of two, which the record keeps as exponents
+static int exponentOf( int value)
+{
+    return (value == 0) ? 0 : __builtin_ctz( value);
+}
+
+
+uint32_t boardHash( const int board[], int squaresPerSide)
+{
+    uint32_t hash = 2166136261u;   // FNV-1a
+    for( int i=0; i<squaresPerSide * squaresPerSide; i++) {
+        hash = (hash ^ (uint32_t)exponentOf( board[ i])) * 16777619u;
+    }
+    return hash;
+}
+
+
+//--------------------------------------------------------------------
+GameRecord::GameRecord()
+    : seed( 0), stream( 0), squaresPerSide( 0), open( false)
+{
+}
+
+
+void GameRecord::setOrigin( uint64_t seed, uint64_t stream)
+{
+    this->seed = seed;
+    this->stream = stream;
+}
+
+
+void GameRecord::put( uint64_t value, int bytes)
+{
+    for( int i=0; i<bytes; i++) {
+        data.push_back( (unsigned char)(value >> (8*i)));
+    }
+}
+
+
+void GameRecord::begin( int squaresPerSide, int Tile, const int board[])
+{
+    data.clear();
+    this->squaresPerSide = squaresPerSide;
+    int cells = squaresPerSide * squaresPerSide;
+    put( squaresPerSide, 1);
+    put( (uint32_t)Tile, 4);
+    put( seed, 8);
+    put( stream, 8);
+    int tiles = 0;
+    for( int i=0; i<cells; i++) {
+        tiles += (board[ i] != 0);
+    }
+    put( tiles, 1);
+    for( int i=0; i<cells; i++) {
+        if( board[ i] != 0) {
+            put( i, 1);
+            put( exponentOf( board[ i]), 1);
+        }
+    }
+    open = true;
+}
+
+
+void GameRecord::move( char direction, int square, int value)
+{
+    int d = 0;
+    while( d < 3 && Directions[ d] != direction) {
+        d++;
+    }
+    put( EventMove | d | (value == 4 ? EventFour : 0), 1);
+    put( square, 1);
+}
+
+
+void GameRecord::place( int square, int value)
+{
+    put( EventPlace, 1);
+    put( square, 1);
+    put( exponentOf( value), 1);
+}
+
+
+void GameRecord::undo()
+{
+    put( EventUndo, 1);
+}
+
+
+void GameRecord::redo()
+{
+    put( EventRedo, 1);
+}
+
+
+void GameRecord::end( int score, int moves, const int board[])
+{
+    put( EventEnd, 1);
+    put( (uint32_t)score, 4);
+    put( (uint32_t)moves, 4);
+    put( boardHash( board, squaresPerSide), 4);
+    open = false;
+}
+
+
+//--------------------------------------------------------------------
+RecordWriter::RecordWriter()
+    : pFile( NULL), written( 0), failed( false)
+{
+}
+
+
+RecordWriter::~RecordWriter()
+{
+    close();
+}
+
+
+bool RecordWriter::open( const char *path)
+{
+    close();
+    pFile = fopen( path, "wb");
+    if( pFile == NULL) {
+        return false;
+    }
+    buffer.reserve( WriteBufferBytes);
+    buffer.assign( FileMagic, FileMagic + MagicBytes);
+    written = 0;
+    failed = false;
+    return true;
+}
+
+
+void RecordWriter::write( const GameRecord &record)
+{
+    std::lock_guard<std::mutex> guard( lock);
+    if( pFile == NULL) {
+        return;
+    }
+    const std::vector<unsigned char> &bytes = record.bytes();
+    buffer.insert( buffer.end(), bytes.begin(), bytes.end());
+    written++;
+    if( (int)buffer.size() >= WriteBufferBytes) {
+        flush();
+    }
+}
+
+
+void RecordWriter::flush()
+{
+    if( !buffer.empty()) {
+        if( fwrite( &buffer[ 0], 1, buffer.size(), pFile) != buffer.size()) {
+            failed = true;
+        }
+        buffer.clear();
+    }
+}
+
+
+bool RecordWriter::close()
+{
+    std::lock_guard<std::mutex> guard( lock);
+    if( pFile == NULL) {
+        return false;
+    }
+    flush();
+    if( fflush( pFile) != 0) {
+        failed = true;
+    }
+    if( fclose( pFile) != 0) {
+        failed = true;
+    }
+    pFile = NULL;
+    return !failed;
+}
+
+
+//--------------------------------------------------------------------
+// Reads little-endian numbers from the mapped file, failing at its end
+struct RecordCursor
+{
+    const unsigned char *pNext;
+    const unsigned char *pEnd;
+
+    bool take( uint64_t &value, int bytes)
+    {
+        if( pEnd - pNext < bytes) {
+            return false;
+        }
+        value = 0;
+        for( int i=0; i<bytes; i++) {
+            value |= (uint64_t)pNext[ i] << (8*i);
+        }
+        pNext += bytes;
+        return true;
+    }
+};
+
+
+// Replay the game starting at the cursor.  Returns false with a description in
+// problem if the record is cut short or the game does not play out as recorded.
+static bool replayGame( RecordCursor &cursor, long &moves, std::string &problem)
+{
+    uint64_t size, Tile, seed, stream, tiles;
+    if( !cursor.take( size, 1) || !cursor.take( Tile, 4) || !cursor.take( seed, 8)
+        || !cursor.take( stream, 8) || !cursor.take( tiles, 1)) {
+        problem = "game header cut short";
+        return false;
+    }
+    int squaresPerSide = (int)size;
+    if( squaresPerSide < 4 || squaresPerSide > MaxBoardSize) {
+        problem = "bad board size";
+        return false;
+    }
+    int cells = squaresPerSide * squaresPerSide;
+    const BoardKernels &kernels = boardKernels( squaresPerSide);
+
+    int board[ MaxBoardSize * MaxBoardSize];
+    for( int i=0; i<cells; i++) {
+        board[ i] = 0;
+    }
+    for( uint64_t t=0; t<tiles; t++) {
+        uint64_t square, exponent;
+        if( !cursor.take( square, 1) || !cursor.take( exponent, 1) || (int)square >= cells
+            || exponent == 0 || exponent > MaxExponent) {
+            problem = "bad starting tile";
+            return false;
+        }
+        board[ square] = 1 << exponent;
+    }
+
+    UndoHistory history;
+    history.reset( squaresPerSide);
+    int score = 0;
+    int step = 0;
+    history.push( board, score, step);
+
+    while( true) {
+        uint64_t event;
+        if( !cursor.take( event, 1)) {
+            problem = "game cut short";
+            return false;
+        }
+        int kind = (int)event & 0xF0;
+        if( kind == EventMove) {
+            uint64_t square;
+            if( !cursor.take( square, 1) || (int)square >= cells) {
+                problem = "bad move";
+                return false;
+            }
+            if( !applyMove( kernels, board, Directions[ event & 3], score).changed) {
+                problem = "move does not change the board";
+                return false;
+            }
+            if( board[ square] != 0) {
+                problem = "new piece placed on a full square";
+                return false;
+            }
+            board[ square] = (event & EventFour) ? 4 : 2;
+            step++;
+            moves++;
+            history.push( board, score, step);
+        }
+        else if( kind == EventPlace) {
+            uint64_t square, exponent;
+            if( !cursor.take( square, 1) || !cursor.take( exponent, 1) || (int)square >= cells
+                || exponent > MaxExponent) {
+                problem = "bad placed piece";
+                return false;
+            }
+            board[ square] = (exponent == 0) ? 0 : (1 << exponent);
+        }
+        else if( kind == EventUndo) {
+            if( !history.pop( board, score, step)) {
+                problem = "undo past the beginning of the game";
+                return false;
+            }
+        }
+        else if( kind == EventRedo) {
+            if( !history.redo( board, score, step)) {
+                problem = "redo with nothing undone";
+                return false;
+            }
+        }
+        else if( kind == EventEnd) {
+            uint64_t endScore, endMoves, hash;
+            if( !cursor.take( endScore, 4) || !cursor.take( endMoves, 4) || !cursor.take( hash, 4)) {
+                problem = "game end cut short";
+                return false;
+            }
+            if( (int)endScore != score || (int)endMoves != step) {
+                problem = "final score or move count differs";
+                return false;
+            }
+            if( (uint32_t)hash != boardHash( board, squaresPerSide)) {
+                problem = "final board differs";
+                return false;
+            }
+            return true;
+        }
+        else {
+            problem = "unknown event";
+            return false;
+        }
+    }
+}
+
+
+bool replayRecords( const char *path, ReplayStats &stats, std::ostream &out)
+{
+    stats.games = 0;
+    stats.moves = 0;
+    stats.seconds = 0;
+
+    int fd = ::open( path, O_RDONLY);
+    if( fd < 0) {
+        out << "Unable to open " << path << std::endl;
+        return false;
+    }
+    struct stat info;
+    if( fstat( fd, &info) != 0 || info.st_size < MagicBytes) {
+        out << path << " is not a game record file" << std::endl;
+        ::close( fd);
+        return false;
+    }
+    size_t length = (size_t)info.st_size;
+    void *pMap = mmap( NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close( fd);
+    if( pMap == MAP_FAILED) {
+        out << "Unable to map " << path << std::endl;
+        return false;
+    }
+    madvise( pMap, length, MADV_SEQUENTIAL);
+
+    RecordCursor cursor;
+    cursor.pNext = (const unsigned char *)pMap;
+    cursor.pEnd = cursor.pNext + length;
+    bool ok = (memcmp( cursor.pNext, FileMagic, MagicBytes) == 0);
+    if( !ok) {
+        out << path << " is not a game record file" << std::endl;
+    }
+    cursor.pNext += MagicBytes;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    while( ok && cursor.pNext < cursor.pEnd) {
+        long offset = (long)(cursor.pNext - (const unsigned char *)pMap);
+        std::string problem;
+        ok = replayGame( cursor, stats.moves, problem);
+        if( ok) {
+            stats.games++;
+        }
+        else {
+            out << "Game " << stats.games << " at byte " << offset << ": " << problem << std::endl;
+        }
+    }
+    stats.seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start).count();
+
+    munmap( pMap, length);
+    return ok;
+}
@@ -0,0 +1,114 @@
+//
+// Binary game records for 1024.
+//
+// A record file holds any number of complete games, so that games can be archived by
+// the million and replayed later at engine speed, to reproduce a bug or build a data
+// set without simulating again.  All numbers are little-endian.
+//
+//   File header   "1024REC1"
+//   Game header   size (1 byte), winning tile (4), seed (8), stream (8),
+//                 starting tiles (1), then a square and an exponent (1 + 1) per tile
+//   Events        one byte, the kind in the high four bits:
+//                   Move   direction in bits 0-1 (w a s d), bit 2 set if a 4 was placed,
+//                          then the square the new piece went to (1)
+//                   Place  square and exponent (1 + 1) of a piece put down by hand
+//                   Undo, Redo
+//                   End    score (4), moves (4) and a hash of the final board (4)
+//
+// A move takes two bytes, so a long 4x4 game records in a few kilobytes.
+//
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <stdint.h>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+
+// Builds the bytes of one game as it is played
+class GameRecord
+{
+public:
+    GameRecord();
+
+    // The seed and stream of the generator the game is played with, written to the header
+    void setOrigin( uint64_t seed, uint64_t stream);
+
+    // Start the game, with the starting pieces already on the board
+    void begin( int squaresPerSide, int Tile, const int board[]);
+
+    // A move in direction that changed the board, after which value was placed on square
+    void move( char direction, int square, int value);
+    void place( int square, int value);
+    void undo();
+    void redo();
+
+    // Finish the game.  moves counts the moves made since begin, less any undone.
+    void end( int score, int moves, const int board[]);
+
+    bool isOpen() const { return open; }
+    const std::vector<unsigned char> &bytes() const { return data; }
+
+private:
+    std::vector<unsigned char> data;
+    uint64_t seed;
+    uint64_t stream;
+    int squaresPerSide;
+    bool open;          // begun and not yet ended
+
+    void put( uint64_t value, int bytes);
+};
+
+
+// Appends finished games to a record file, buffering the writes.  Games may be
+// written from several threads at once; each one is written whole.
+class RecordWriter
+{
+public:
+    RecordWriter();
+    ~RecordWriter();
+
+    // Create the file and write its header.  Returns false if it cannot be created.
+    bool open( const char *path);
+    void write( const GameRecord &record);
+
+    // Write out what is buffered and close the file.  Returns false if any of the
+    // file could not be written, or if it was never opened.
+    bool close();
+
+    long games() const { return written; }
+
+private:
+    FILE *pFile;
+    std::vector<unsigned char> buffer;
+    std::mutex lock;
+    long written;
+    bool failed;        // a write to the file has failed since it was opened
+
+    void flush();
+};
+
+
+struct ReplayStats
+{
+    long games;
+    long moves;
+    double seconds;
+};
+
+
+// Map a record file into memory and replay every game in it with the move kernels,
+// checking that each move changes the board, each new piece lands on an empty square,
+// each undo and redo is possible, and that the score, moves and final board at the
+// end of each game match the record.  Prints the first mismatch found to out and
+// returns false, or returns true when every game replays exactly.
+bool replayRecords( const char *path, ReplayStats &stats, std::ostream &out);
+
+// Hash of the exponents on a board, as stored at the end of each game.  Like the rest
+// of the record it keeps each tile as its exponent, so every tile must be a power of
+// two, as placeableTile() ensures for pieces put down by hand.
+uint32_t boardHash( const int board[], int squaresPerSide);
+
+#endif
@@ -0,0 +1,253 @@
+//
+// Retained-mode board renderer for 1024.  See renderer.h.
+//
+#include "renderer.h"
+#include <algorithm>         // For min(), max()
+#include <cstdio>            // For sprintf, "printing" to a string
+#include <cstring>           // For strlen()
+
+
+const int LabelMargin = 4;      // pixels kept clear on each side of a number
+const sf::Color EmptyColor( 120, 120, 120);
+const sf::Color TileColor = sf::Color::White;
+
+
+BoardLayout layoutBoard( int squaresPerSide, const sf::FloatRect &area)
+{
+    BoardLayout layout;
+    layout.squaresPerSide = squaresPerSide;
+    float room = std::min( area.width, area.height);
+    layout.squareSize = std::max( 1, (int)(room / (squaresPerSide + (squaresPerSide - 1) * SquareGapRatio)));
+    layout.gap = std::max( 1, (int)(layout.squareSize * SquareGapRatio + 0.5f));
+    while( layout.squareSize > 1 && squaresPerSide * layout.squareSize + (squaresPerSide - 1) * layout.gap > room) {
+        layout.squareSize--;    // rounding the gap up can push the board past the edge
+    }
+    layout.textSize = std::max( MinTileTextSize, (int)(layout.squareSize * TileTextRatio + 0.5f));
+    int extent = squaresPerSide * layout.squareSize + (squaresPerSide - 1) * layout.gap;
+    layout.origin = sf::Vector2f( (int)(area.left + (area.width - extent) / 2),
+                                  (int)(area.top + (area.height - extent) / 2));
+    return layout;
+}
+
+
+BoardRenderer::BoardRenderer( const sf::Font &font)
+    : font( font), area( 0, 0, 0, 0), stale( true), quads( sf::Quads), digits( sf::Quads), labelSquareSize( 0),
+      grid( sf::Quads), slideQuads( sf::Quads), slideDigits( sf::Quads), slideCount( 0), sliding( false)
+{
+    current.squaresPerSide = 0;
+}
+
+
+void BoardRenderer::setArea( const sf::FloatRect &area)
+{
+    if( area != this->area) {
+        this->area = area;
+        stale = true;
+    }
+}
+
+
+// Lay out the glyphs of a number as textured quads, centered in a square whose top
+// left corner is at 0,0, and shrunk to fit if the number is too wide
+void BoardRenderer::layoutLabel( int value, std::vector<sf::Vertex> &label) const
+{
+    char ident[ 16];
+    sprintf( ident, "%d", value);
+    int length = (int)strlen( ident);
+    if( length > LabelDigits) {
+        length = LabelDigits;
+    }
+
+    // Place the glyphs along a baseline at 0, measuring the box they cover
+    label.clear();
+    float x = 0;
+    float left = 1e9f, top = 1e9f, right = -1e9f, bottom = -1e9f;
+    for( int i=0; i<length; i++) {
+        const sf::Glyph &glyph = font.getGlyph( ident[ i], current.textSize, false);
+        sf::FloatRect box( x + glyph.bounds.left, glyph.bounds.top, glyph.bounds.width, glyph.bounds.height);
+        sf::IntRect texture = glyph.textureRect;
+        label.push_back( sf::Vertex( sf::Vector2f( box.left, box.top), sf::Color::Black,
+                                     sf::Vector2f( texture.left, texture.top)));
+        label.push_back( sf::Vertex( sf::Vector2f( box.left + box.width, box.top), sf::Color::Black,
+                                     sf::Vector2f( texture.left + texture.width, texture.top)));
+        label.push_back( sf::Vertex( sf::Vector2f( box.left + box.width, box.top + box.height), sf::Color::Black,
+                                     sf::Vector2f( texture.left + texture.width, texture.top + texture.height)));
+        label.push_back( sf::Vertex( sf::Vector2f( box.left, box.top + box.height), sf::Color::Black,
+                                     sf::Vector2f( texture.left, texture.top + texture.height)));
+        left = std::min( left, box.left);
+        top = std::min( top, box.top);
+        right = std::max( right, box.left + box.width);
+        bottom = std::max( bottom, box.top + box.height);
+        x += glyph.advance;
+    }
+
+    // Scale down numbers wider than the square, then move the box to its center
+    float room = std::max( 1, current.squareSize - 2 * LabelMargin);
+    float scale = (right - left > room) ? room / (right - left) : 1;
+    float xOffset = (current.squareSize - scale * (right - left)) / 2;
+    float yOffset = (current.squareSize - scale * (bottom - top)) / 2;
+    for( size_t v=0; v<label.size(); v++) {
+        sf::Vector2f &position = label[ v].position;
+        position.x = (int)(xOffset + scale * (position.x - left));
+        position.y = (int)(yOffset + scale * (position.y - top));
+    }
+}
+
+
+// Set the corners of the quad for a square whose top left corner is at x,y
+static void placeQuad( sf::Vertex *pQuad, float x, float y, int size, const sf::Color &color)
+{
+    pQuad[ 0].position = sf::Vector2f( x, y);
+    pQuad[ 1].position = sf::Vector2f( x + size, y);
+    pQuad[ 2].position = sf::Vector2f( x + size, y + size);
+    pQuad[ 3].position = sf::Vector2f( x, y + size);
+    for( int corner=0; corner<4; corner++) {
+        pQuad[ corner].color = color;
+    }
+}
+
+
+// Top left corner of a square
+sf::Vector2f BoardRenderer::squareCorner( int index) const
+{
+    int pitch = current.squareSize + current.gap;
+    return sf::Vector2f( current.origin.x + (index % current.squaresPerSide) * pitch,
+                         current.origin.y + (index / current.squaresPerSide) * pitch);
+}
+
+
+// Place every square's quad for a new board size or area, all of them empty, and lay
+// the numbers out again if the squares they are centered in changed size.  A slide under way is
+// dropped, since its squares have moved.
+void BoardRenderer::layout( int squaresPerSide)
+{
+    current = layoutBoard( squaresPerSide, area);
+    stale = false;
+    sliding = false;
+    if( current.squareSize != labelSquareSize) {
+        labelSquareSize = current.squareSize;
+        for( int exponent=1; exponent<LabelExponents; exponent++) {
+            layoutLabel( 1 << exponent, labels[ exponent]);
+        }
+    }
+    int cells = squaresPerSide * squaresPerSide;
+    quads.resize( 4 * cells);
+    digits.resize( 4 * LabelDigits * cells);
+    grid.resize( 4 * cells);
+    for( int i=0; i<cells; i++) {
+        sf::Vector2f corner = squareCorner( i);
+        placeQuad( &quads[ 4*i], corner.x, corner.y, current.squareSize, EmptyColor);
+        placeQuad( &grid[ 4*i], corner.x, corner.y, current.squareSize, EmptyColor);
+        shown[ i] = -1;   // so the first update sets every square
+    }
+}
+
+
+// Copy the number for a value into LabelDigits quads, placed in a square whose top left
+// corner is given
+void BoardRenderer::placeLabel( int value, const sf::Vector2f &corner, sf::Vertex *pDigits) const
+{
+    // Powers of two come ready-made; anything else placed by hand is laid out now
+    std::vector<sf::Vertex> other;
+    const std::vector<sf::Vertex> *pLabel = &other;
+    if( value > 0 && (value & (value - 1)) == 0 && __builtin_ctz( value) < LabelExponents) {
+        pLabel = &labels[ __builtin_ctz( value)];
+    }
+    else if( value != 0) {
+        layoutLabel( value, other);   // Squares with a 0 value should not have a number displayed
+    }
+
+    for( int v=0; v<4 * LabelDigits; v++) {
+        if( v < (int)pLabel->size()) {
+            pDigits[ v] = (*pLabel)[ v];
+            pDigits[ v].position.x += corner.x;
+            pDigits[ v].position.y += corner.y;
+        }
+        else {
+            pDigits[ v] = sf::Vertex();   // an empty quad, which draws nothing
+        }
+    }
+}
+
+
+// Colour one square's quad and copy the number for its value into its digit quads
+void BoardRenderer::setSquare( int index, int value)
+{
+    shown[ index] = value;
+    sf::Vertex *pQuad = &quads[ 4*index];
+    for( int corner=0; corner<4; corner++) {
+        pQuad[ corner].color = (value != 0) ? TileColor : EmptyColor;
+    }
+    placeLabel( value, pQuad[ 0].position, &digits[ 4 * LabelDigits * index]);
+}
+
+
+void BoardRenderer::animate( const int before[], const MoveMotions &motions)
+{
+    if( current.squaresPerSide == 0 || stale) {
+        return;   // not laid out yet, so there is nowhere to slide from
+    }
+    slideCount = motions.count;
+    for( int m=0; m<motions.count; m++) {
+        const TileMotion &motion = motions.motions[ m];
+        slides[ m].from = squareCorner( motion.source);
+        slides[ m].to = squareCorner( motion.destination);
+        slides[ m].value = before[ motion.source];
+    }
+    slideQuads.resize( 4 * slideCount);
+    slideDigits.resize( 4 * LabelDigits * slideCount);
+    slideStart = std::chrono::steady_clock::now();
+    sliding = (slideCount > 0);
+}
+
+
+// Move every sliding tile's quads to where it is a fraction t of the way through the slide
+void BoardRenderer::placeSlides( float t)
+{
+    float eased = 1 - (1 - t) * (1 - t);   // fast at first, slowing as the tiles arrive
+    for( int i=0; i<slideCount; i++) {
+        const Slide &slide = slides[ i];
+        sf::Vector2f corner( (int)(slide.from.x + (slide.to.x - slide.from.x) * eased),
+                             (int)(slide.from.y + (slide.to.y - slide.from.y) * eased));
+        placeQuad( &slideQuads[ 4*i], corner.x, corner.y, current.squareSize, TileColor);
+        placeLabel( slide.value, corner, &slideDigits[ 4 * LabelDigits * i]);
+    }
+}
+
+
+int BoardRenderer::update( const int board[], int squaresPerSide)
+{
+    if( squaresPerSide != current.squaresPerSide || stale) {
+        layout( squaresPerSide);
+    }
+    if( sliding) {
+        float t = std::chrono::duration<float>( std::chrono::steady_clock::now() - slideStart).count() / SlideSeconds;
+        if( t < 1) {
+            placeSlides( t);
+            return slideCount;
+        }
+        sliding = false;   // the tiles have arrived, so show the board as it is now
+    }
+    int changed = 0;
+    for( int i=0; i<squaresPerSide * squaresPerSide; i++) {
+        if( board[ i] != shown[ i]) {
+            setSquare( i, board[ i]);
+            changed++;
+        }
+    }
+    return changed;
+}
+
+
+int BoardRenderer::draw( sf::RenderTarget &target) const
+{
+    if( sliding) {
+        target.draw( grid);
+        target.draw( slideQuads);
+        target.draw( slideDigits, sf::RenderStates( &font.getTexture( current.textSize)));
+        return 3;
+    }
+    target.draw( quads);
+    target.draw( digits, sf::RenderStates( &font.getTexture( current.textSize)));
+    return 2;
+}
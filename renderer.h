@@ -0,0 +1,113 @@
+//
+// Retained-mode board renderer for 1024.
+//
+// Keeps the quads for every square in one vertex array, built when the board size is
+// set, and the numbers on the squares in a second one, textured from the font's glyph
+// page.  The layout of every tile value's number, centered from the glyph bounds, is
+// worked out once when the renderer is created, so each frame only copies ready-made
+// quads into the squares whose value changed, and the whole board is drawn with two
+// draw calls.
+//
+// The size of the squares, the gaps between them and the numbers on them are worked out
+// from the board size and the part of the window the board is given, so every board
+// from 4x4 to 12x12 fits the window at any size.  This is done again only when one of
+// those changes, not on every frame.
+//
+// Moves can be animated: given where each tile went, the tiles slide from their old
+// squares to their new ones over SlideSeconds, drawn over the empty grid as one more
+// vertex array that is rebuilt each frame, and then the new board is shown.
+//
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <SFML/Graphics.hpp>
+#include <chrono>            // For steady_clock
+#include <vector>
+#include "game.h"
+#include "boardkernels.h"
+
+
+// Proportions of a square, taken from the original 4x4 board: 55-pixel squares, 10
+// pixels apart, with 30-point numbers
+const float SquareGapRatio = 10.0f / 55;
+const float TileTextRatio = 30.0f / 55;
+const int MinTileTextSize = 6;
+const int LabelDigits = 10;     // digits of MaxPlaceableTile, the longest number a square can hold
+const int LabelExponents = 19;  // numbers for 2 up to 2^18, past the largest winning tile
+const float SlideSeconds = 0.1f;
+
+
+// Where the squares of a board go
+struct BoardLayout
+{
+    int squaresPerSide;
+    sf::Vector2f origin;    // top left corner of the board
+    int squareSize;         // pixels per side of a square
+    int gap;                // pixels between squares
+    int textSize;           // character size of the numbers
+};
+
+// The largest board of squaresPerSide squares that fits in area, centered in it.  Sizes
+// are whole pixels so the squares stay sharp.
+BoardLayout layoutBoard( int squaresPerSide, const sf::FloatRect &area);
+
+
+class BoardRenderer
+{
+public:
+    // The font must outlive the renderer
+    explicit BoardRenderer( const sf::Font &font);
+
+    // Give the board the part of the window it is drawn in
+    void setArea( const sf::FloatRect &area);
+
+    // Bring the quads up to date with the board, laying the board out again if its size
+    // or its area changed.  Returns the number of squares that changed.
+    int update( const int board[], int squaresPerSide);
+
+    const BoardLayout &currentLayout() const { return current; }
+
+    // Start sliding the tiles of before, the board as it was drawn last, to the squares
+    // the motions of a move took them to.  Until the slide is over, update moves the
+    // tiles along instead of showing the board it is given.
+    void animate( const int before[], const MoveMotions &motions);
+    bool animating() const { return sliding; }
+
+    // Draw the board into the window, as last updated.  Returns the number of draw calls.
+    int draw( sf::RenderTarget &target) const;
+
+private:
+    const sf::Font &font;
+    sf::FloatRect area;
+    BoardLayout current;
+    bool stale;                            // the area changed since the board was laid out
+    sf::VertexArray quads;                 // four corners per square
+    sf::VertexArray digits;                // LabelDigits quads per square, unused ones empty
+    std::vector<sf::Vertex> labels[ LabelExponents];   // number for each power of two, centered in a square at 0,0
+    int labelSquareSize;                   // square size the labels were laid out for; sets their text size too
+    int shown[ MaxBoardSize * MaxBoardSize];   // value each square was last updated to
+
+    // A tile sliding during a move, from one square's top left corner to another's
+    struct Slide
+    {
+        sf::Vector2f from;
+        sf::Vector2f to;
+        int value;
+    };
+    sf::VertexArray grid;                  // every square empty, drawn under the sliding tiles
+    sf::VertexArray slideQuads;
+    sf::VertexArray slideDigits;
+    Slide slides[ MaxBoardSize * MaxBoardSize];
+    int slideCount;
+    bool sliding;
+    std::chrono::steady_clock::time_point slideStart;
+
+    void layout( int squaresPerSide);
+    void layoutLabel( int value, std::vector<sf::Vertex> &label) const;
+    sf::Vector2f squareCorner( int index) const;
+    void placeLabel( int value, const sf::Vector2f &corner, sf::Vertex *pDigits) const;
+    void setSquare( int index, int value);
+    void placeSlides( float t);
+};
+
+#endif
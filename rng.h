@@ -0,0 +1,84 @@
+//
+// Fast seedable random number generator for games.
+//
+// Each game owns a GameRng instead of sharing the global rand() state, so games on
+// different threads do not interfere, and a game started from the same seed places
+// the same pieces again, which lets any game be replayed exactly.  The generator is
+// xoshiro256**, seeded through splitmix64.
+//
+#ifndef RNG_H
+#define RNG_H
+
+#include <cstdint>
+
+
+class GameRng
+{
+public:
+    // Games with the same seed and different streams get independent sequences,
+    // e.g. stream i for game i of a batch.
+    explicit GameRng( uint64_t seed = 1, uint64_t stream = 0)
+    {
+        reseed( seed, stream);
+    }
+
+    void reseed( uint64_t seed, uint64_t stream = 0)
+    {
+        uint64_t x = seed ^ (stream * 0xD1B54A32D192ED03ULL);
+        for( int i=0; i<4; i++) {
+            state[ i] = splitmix64( x);
+        }
+    }
+
+    uint64_t next()
+    {
+        uint64_t result = rotateLeft( state[ 1] * 5, 7) * 9;
+        uint64_t t = state[ 1] << 17;
+        state[ 2] ^= state[ 0];
+        state[ 3] ^= state[ 1];
+        state[ 1] ^= state[ 2];
+        state[ 0] ^= state[ 3];
+        state[ 2] ^= t;
+        state[ 3] = rotateLeft( state[ 3], 45);
+        return result;
+    }
+
+    // Uniform value in [0, n), without the bias of next() % n
+    uint32_t below( uint32_t n)
+    {
+        uint64_t product = (next() >> 32) * n;
+        uint32_t low = (uint32_t)product;
+        if( low < n) {
+            uint32_t threshold = (0u - n) % n;
+            while( low < threshold) {
+                product = (next() >> 32) * n;
+                low = (uint32_t)product;
+            }
+        }
+        return (uint32_t)(product >> 32);
+    }
+
+    // Uniform value in [0, 1)
+    double uniform()
+    {
+        return (next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+private:
+    static uint64_t rotateLeft( uint64_t x, int k)
+    {
+        return (x << k) | (x >> (64 - k));
+    }
+
+    static uint64_t splitmix64( uint64_t &x)
+    {
+        uint64_t z = (x += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    uint64_t state[ 4];
+};
+
+#endif
@@ -0,0 +1,445 @@
+//
+// Game server for 1024.
+//
+// Serves many independent games at once, each a session in a SessionTable, to clients
+// that send the text commands described in sessions.h over a TCP port or a Unix socket
+// and read back one line per command.  Nothing is tied to a window or to stdin, so one
+// process can host thousands of games.
+//
+// Every worker thread waits on its own epoll instance.  The listening socket is in all
+// of them with EPOLLEXCLUSIVE, so each new connection wakes a single worker, which then
+// serves that connection until it closes.  Sockets never block: a worker reads whatever
+// has arrived, runs each complete line, and keeps any reply the socket cannot take yet
+// until it is writable again.  A client that sends commands faster than it reads the
+// replies is not read from while MaxPendingOutput bytes of its replies are waiting, so
+// its own socket buffer pushes back on it.  The session table is split into shards with
+// a lock each, so the workers share the sessions without queueing behind one another.
+// Meanwhile the main thread ends the sessions no one has used for a while.
+//
+// To build and run:
+//    cmake -S . -B build && cmake --build build --target server loadgen
+// or
+//    g++ -O2 -pthread server.cpp sessions.cpp game.cpp history.cpp boardkernels.cpp
+//        simdrows.cpp bitboard.cpp -o server
+//    ./server --port 10240 --threads 4
+//    ./loadgen --port 10240 --sessions 2000
+// The server runs until it is interrupted, then prints how much it served.
+//
+#include <iostream>          // For cout, endl
+#include <atomic>
+#include <chrono>            // For steady_clock, to time the idle sweeps
+#include <csignal>           // For signal()
+#include <cstdlib>           // For atoi(), strtoull()
+#include <cstring>           // For strcmp(), memset()
+#include <string>
+#include <thread>
+#include <vector>
+#include <errno.h>
+#include <fcntl.h>           // For fcntl(), to make the listening socket non-blocking
+#include <unistd.h>          // For read(), write(), close()
+#include <netinet/in.h>      // For sockaddr_in
+#include <netinet/tcp.h>     // For TCP_NODELAY
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>          // For sockaddr_un
+#include "sessions.h"
+using namespace std;
+
+#ifndef EPOLLEXCLUSIVE
+#define EPOLLEXCLUSIVE (1u << 28)   // Linux 4.5, missing from older headers
+#endif
+
+
+const int DefaultPort = 10240;
+const int MaxEvents = 64;            // events taken from epoll at once
+const int StopCheckMs = 200;         // longest wait before a worker checks for stopping
+const size_t MaxLineLength = 1024;   // a longer line closes the connection
+const size_t MaxPendingOutput = 64 * 1024;   // unsent reply bytes at which a connection stops being read
+const int IdleSweepSeconds = 10;     // time between looks for idle sessions
+
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void requestStop( int)
+{
+    stopRequested = 1;
+}
+
+
+// One client's socket, its partly received command and its replies not yet sent
+struct Connection
+{
+    int fd;
+    uint64_t session;     // the session commands without an id go to, 0 for none
+    string input;
+    string output;
+    size_t sent;          // bytes of output already written
+    uint32_t watching;    // the events epoll waits for on the socket
+    bool ended;           // the client has sent all it will; close once its replies are out
+};
+
+
+struct ServerStats
+{
+    atomic<long> connections;
+    atomic<long> commands;
+
+    ServerStats() : connections( 0), commands( 0) {}
+};
+
+
+//--------------------------------------------------------------------
+void displayUsage()
+{
+    cout << "Usage: server [options]\n"
+         << "  --port N           TCP port to listen on, on every interface (default " << DefaultPort << ")\n"
+         << "  --unix PATH        listen on a Unix socket instead\n"
+         << "  --threads N        worker threads, 0 for one per core (default 0)\n"
+         << "  --sessions N       most sessions open at once (default " << DefaultMaxSessions << ")\n"
+         << "  --idle S           end sessions with no command for S seconds, 0 for never (default "
+         << DefaultIdleSeconds << ")\n"
+         << "  --seed N           seed for the sessions' pieces (default 1)\n";
+}
+
+
+// Bind and listen on the TCP port, or on the Unix socket if path is given.  Returns -1
+// on failure.
+int openListener( int port, const char *path)
+{
+    int fd;
+    if( path != NULL) {
+        sockaddr_un address;
+        memset( &address, 0, sizeof( address));
+        address.sun_family = AF_UNIX;
+        if( strlen( path) >= sizeof( address.sun_path)) {
+            return -1;
+        }
+        strcpy( address.sun_path, path);
+        unlink( path);   // left behind by an earlier run
+        fd = socket( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if( fd < 0) {
+            return -1;
+        }
+        if( bind( fd, (sockaddr *)&address, sizeof( address)) != 0) {
+            close( fd);
+            return -1;
+        }
+    }
+    else {
+        sockaddr_in address;
+        memset( &address, 0, sizeof( address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl( INADDR_ANY);
+        address.sin_port = htons( port);
+        fd = socket( AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if( fd < 0) {
+            return -1;
+        }
+        int on = 1;
+        if( setsockopt( fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof( on)) != 0
+            || bind( fd, (sockaddr *)&address, sizeof( address)) != 0) {
+            close( fd);
+            return -1;
+        }
+    }
+    if( listen( fd, SOMAXCONN) != 0 || fcntl( fd, F_SETFL, O_NONBLOCK) != 0) {
+        close( fd);
+        return -1;
+    }
+    return fd;
+}
+
+
+//--------------------------------------------------------------------
+// One worker thread: its epoll instance and the connections it serves
+class Worker
+{
+public:
+    Worker( int listener, bool tcp, SessionTable &table, ServerStats &stats)
+        : listener( listener), tcp( tcp), table( table), stats( stats)
+    {
+        epollFd = epoll_create1( EPOLL_CLOEXEC);
+        epoll_event event;
+        event.events = EPOLLIN | EPOLLEXCLUSIVE;
+        event.data.ptr = NULL;   // marks the listener
+        epoll_ctl( epollFd, EPOLL_CTL_ADD, listener, &event);
+    }
+
+    ~Worker()
+    {
+        for( size_t i=0; i<open.size(); i++) {
+            close( open[ i]->fd);
+            delete open[ i];
+        }
+        close( epollFd);
+    }
+
+    void run()
+    {
+        epoll_event events[ MaxEvents];
+        while( !stopRequested) {
+            int count = epoll_wait( epollFd, events, MaxEvents, StopCheckMs);
+            for( int e=0; e<count; e++) {
+                Connection *pConnection = (Connection *)events[ e].data.ptr;
+                if( pConnection == NULL) {
+                    acceptConnections();
+                }
+                else if( !serve( *pConnection, events[ e].events)) {
+                    drop( pConnection);
+                }
+            }
+        }
+    }
+
+private:
+    void acceptConnections()
+    {
+        for( ;;) {
+            int fd = accept4( listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if( fd < 0) {
+                return;   // EAGAIN once another worker or this one has taken them all
+            }
+            if( tcp) {
+                int on = 1;
+                setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof( on));   // replies are small and awaited
+            }
+            Connection *pConnection = new Connection;
+            pConnection->fd = fd;
+            pConnection->session = 0;
+            pConnection->sent = 0;
+            pConnection->watching = EPOLLIN;
+            pConnection->ended = false;
+            epoll_event event;
+            event.events = EPOLLIN;
+            event.data.ptr = pConnection;
+            epoll_ctl( epollFd, EPOLL_CTL_ADD, fd, &event);
+            open.push_back( pConnection);
+            stats.connections++;
+        }
+    }
+
+    // Read and run what has arrived, then send what can be sent, a read at a time so
+    // that no more is read while too many replies are waiting.  Returns false once the
+    // connection should be closed: broken, or ended by the client with every reply sent.
+    bool serve( Connection &connection, uint32_t events)
+    {
+        bool readable = (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) != 0;
+        char buffer[ 4096];
+        for( ;;) {
+            if( !runLines( connection) || !flush( connection)) {
+                return false;
+            }
+            if( backedUp( connection)) {
+                break;   // wait for the client to read its replies
+            }
+            if( connection.input.find( '\n') != string::npos) {
+                continue;   // lines left over from when it was backed up
+            }
+            if( connection.ended) {
+                if( connection.sent < connection.output.size()) {
+                    break;   // wait until the socket takes the rest of the replies
+                }
+                return false;
+            }
+            if( !readable) {
+                break;
+            }
+            ssize_t length = read( connection.fd, buffer, sizeof( buffer));
+            if( length > 0) {
+                connection.input.append( buffer, length);
+                continue;
+            }
+            if( length == 0) {
+                connection.ended = true;   // the lines already sent are still answered
+                continue;
+            }
+            if( errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                return false;   // broken
+            }
+            if( errno != EINTR) {
+                break;
+            }
+        }
+        watch( connection);
+        return true;
+    }
+
+    bool backedUp( const Connection &connection) const
+    {
+        return connection.output.size() - connection.sent > MaxPendingOutput;
+    }
+
+    // Run the complete lines of input, adding the replies to output, until there are no
+    // more or too many replies are waiting.  Returns false for a line that is too long.
+    bool runLines( Connection &connection)
+    {
+        string reply;
+        size_t start = 0;
+        size_t end;
+        while( !backedUp( connection) && (end = connection.input.find( '\n', start)) != string::npos) {
+            connection.input[ end] = '\0';
+            if( end > start && connection.input[ end - 1] == '\r') {
+                connection.input[ end - 1] = '\0';
+            }
+            table.execute( connection.input.c_str() + start, connection.session, reply);
+            connection.output += reply;
+            connection.output += '\n';
+            stats.commands++;
+            start = end + 1;
+        }
+        connection.input.erase( 0, start);
+        return connection.input.size() <= MaxLineLength || connection.input.find( '\n') != string::npos;
+    }
+
+    // Write as much output as the socket takes
+    bool flush( Connection &connection)
+    {
+        while( connection.sent < connection.output.size()) {
+            ssize_t length = write( connection.fd, connection.output.data() + connection.sent,
+                                    connection.output.size() - connection.sent);
+            if( length < 0) {
+                if( errno == EINTR) {
+                    continue;
+                }
+                if( errno != EAGAIN && errno != EWOULDBLOCK) {
+                    return false;
+                }
+                break;
+            }
+            connection.sent += length;
+        }
+        if( connection.sent == connection.output.size()) {
+            connection.output.clear();
+            connection.sent = 0;
+        }
+        return true;
+    }
+
+    // Wait for EPOLLOUT only while some output is left, and for EPOLLIN only while the
+    // connection is not backed up and the client has not ended it
+    void watch( Connection &connection)
+    {
+        uint32_t events = (backedUp( connection) || connection.ended ? 0 : (uint32_t)EPOLLIN)
+                          | (connection.sent < connection.output.size() ? (uint32_t)EPOLLOUT : 0);
+        if( events != connection.watching) {
+            epoll_event event;
+            event.events = events;
+            event.data.ptr = &connection;
+            epoll_ctl( epollFd, EPOLL_CTL_MOD, connection.fd, &event);
+            connection.watching = events;
+        }
+    }
+
+    // Close a connection.  Its sessions stay open, for the client to name again later,
+    // until they have been idle too long.
+    void drop( Connection *pConnection)
+    {
+        epoll_ctl( epollFd, EPOLL_CTL_DEL, pConnection->fd, NULL);
+        close( pConnection->fd);
+        for( size_t i=0; i<open.size(); i++) {
+            if( open[ i] == pConnection) {
+                open[ i] = open.back();
+                open.pop_back();
+                break;
+            }
+        }
+        delete pConnection;
+    }
+
+    int epollFd;
+    int listener;
+    bool tcp;
+    SessionTable &table;
+    ServerStats &stats;
+    vector<Connection *> open;
+
+    Worker( const Worker &);              // not copyable
+    Worker &operator=( const Worker &);
+};
+
+
+//--------------------------------------------------------------------
+int main( int argc, char *argv[])
+{
+    int port = DefaultPort;
+    const char *path = NULL;
+    int threads = 0;
+    int maxSessions = DefaultMaxSessions;
+    int idleSeconds = DefaultIdleSeconds;
+    uint64_t seed = 1;
+    for( int i=1; i<argc; i++) {
+        if( i + 1 >= argc) {
+            displayUsage();
+            return 1;
+        }
+        if( strcmp( argv[ i], "--port") == 0) {
+            port = atoi( argv[ ++i]);
+        }
+        else if( strcmp( argv[ i], "--unix") == 0) {
+            path = argv[ ++i];
+        }
+        else if( strcmp( argv[ i], "--threads") == 0) {
+            threads = atoi( argv[ ++i]);
+        }
+        else if( strcmp( argv[ i], "--sessions") == 0) {
+            maxSessions = atoi( argv[ ++i]);
+        }
+        else if( strcmp( argv[ i], "--idle") == 0) {
+            idleSeconds = atoi( argv[ ++i]);
+        }
+        else if( strcmp( argv[ i], "--seed") == 0) {
+            seed = strtoull( argv[ ++i], NULL, 10);
+        }
+        else {
+            displayUsage();
+            return 1;
+        }
+    }
+    if( threads <= 0) {
+        threads = max( 1, (int)thread::hardware_concurrency());
+    }
+
+    int listener = openListener( port, path);
+    if( listener < 0) {
+        cout << "Unable to listen on " << (path != NULL ? path : "port " + to_string( port)) << "." << endl;
+        return 1;
+    }
+    signal( SIGINT, requestStop);
+    signal( SIGTERM, requestStop);
+    signal( SIGPIPE, SIG_IGN);   // a client that goes away shows up as a failed write instead
+
+    SessionTable table( seed, maxSessions);
+    ServerStats stats;
+    vector<Worker *> workers;
+    vector<thread> running;
+    for( int t=0; t<threads; t++) {
+        workers.push_back( new Worker( listener, path == NULL, table, stats));
+    }
+    for( int t=0; t<threads; t++) {
+        running.push_back( thread( &Worker::run, workers[ t]));
+    }
+    cout << "Serving games on " << (path != NULL ? path : "port " + to_string( port)) << " with "
+         << threads << " threads" << endl;
+
+    // End idle sessions now and then, until the workers are told to stop
+    chrono::steady_clock::time_point nextSweep = chrono::steady_clock::now() + chrono::seconds( IdleSweepSeconds);
+    while( !stopRequested) {
+        this_thread::sleep_for( chrono::milliseconds( StopCheckMs));
+        if( idleSeconds > 0 && chrono::steady_clock::now() >= nextSweep) {
+            table.expireIdle( idleSeconds);
+            nextSweep = chrono::steady_clock::now() + chrono::seconds( IdleSweepSeconds);
+        }
+    }
+    for( int t=0; t<threads; t++) {
+        running[ t].join();
+        delete workers[ t];
+    }
+    close( listener);
+    if( path != NULL) {
+        unlink( path);
+    }
+    cout << "\nServed " << stats.commands << " commands on " << stats.connections << " connections; "
+         << table.startedSessions() << " sessions started, " << table.expiredSessions() << " ended when idle, "
+         << table.liveSessions() << " still open" << endl;
+    return 0;
+}
@@ -0,0 +1,314 @@
+//
+// Table of independent game sessions.  See sessions.h.
+//
+#include "sessions.h"
+#include <cctype>            // For isdigit(), isspace()
+#include <chrono>            // For steady_clock, to find idle sessions
+#include <cstdio>            // For sscanf()
+#include <cstdlib>           // For strtoull()
+#include "boardkernels.h"
+
+
+static const char *skipSpaces( const char *p)
+{
+    while( *p != '\0' && isspace( (unsigned char)*p)) {
+        p++;
+    }
+    return p;
+}
+
+
+static void appendNumber( std::string &text, uint64_t value)
+{
+    char digits[ 24];
+    int length = 0;
+    do {
+        digits[ length++] = (char)('0' + value % 10);
+        value /= 10;
+    } while( value != 0);
+    while( length > 0) {
+        text += digits[ --length];
+    }
+}
+
+
+// Board size from a command's arguments, or fallback if none is given.  Returns 0 for
+// a size that cannot be played.
+static int parseSize( const char *arguments, int fallback)
+{
+    int size = fallback;
+    sscanf( arguments, "%d", &size);
+    return (size >= 4 && size <= MaxBoardSize) ? size : 0;
+}
+
+
+static int64_t nowMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+static void unpackBoard( const Session &session, int play[])
+{
+    for( int i=0; i<session.squaresPerSide * session.squaresPerSide; i++) {
+        play[ i] = (session.board[ i] == 0) ? 0 : 1 << session.board[ i];
+    }
+}
+
+
+static void packBoard( Session &session, const int play[])
+{
+    for( int i=0; i<session.squaresPerSide * session.squaresPerSide; i++) {
+        session.board[ i] = (play[ i] == 0) ? 0 : (unsigned char)__builtin_ctz( play[ i]);
+    }
+}
+
+
+//--------------------------------------------------------------------
+SessionTable::SessionTable( uint64_t seed, int maxSessions)
+    : seed( seed), maxSessions( maxSessions), nextShard( 0), live( 0), started( 0), expired( 0)
+{
+}
+
+
+void SessionTable::execute( const char *line, uint64_t &current, std::string &reply)
+{
+    reply.clear();
+    const char *p = skipSpaces( line);
+    uint64_t id = current;
+    if( isdigit( (unsigned char)*p)) {
+        char *pEnd;
+        id = strtoull( p, &pEnd, 10);
+        p = skipSpaces( pEnd);
+    }
+    char letter = *p;
+    const char *arguments = (letter != '\0') ? p + 1 : p;
+
+    if( letter == 'n') {
+        int size = parseSize( arguments, 4);
+        if( size == 0) {
+            reply = "error the board size must be between 4 and 12";
+            return;
+        }
+        uint64_t newId = startSession( size, reply);
+        if( newId != 0) {
+            current = newId;
+        }
+        return;
+    }
+    if( id == 0) {
+        reply = "error no session; start one with n";
+        return;
+    }
+
+    std::unique_lock<std::mutex> guard;
+    Session *pSession = lockSession( id, guard);
+    if( pSession == NULL) {
+        reply = "error no session ";
+        appendNumber( reply, id);
+        return;
+    }
+    current = id;
+    pSession->lastUsed = nowMs();
+    if( letter == 'x') {
+        appendNumber( reply, id);
+        reply += " ended ";
+        appendNumber( reply, pSession->score);
+        endSession( *pSession, id);
+        current = 0;
+        return;
+    }
+    command( *pSession, id, letter, arguments, reply);
+}
+
+
+uint64_t SessionTable::startSession( int squaresPerSide, std::string &reply)
+{
+    if( live.fetch_add( 1) >= maxSessions) {
+        live--;
+        reply = "error too many sessions";
+        return 0;
+    }
+    unsigned s = nextShard++ % SessionShards;
+    Shard &shard = shards[ s];
+    std::lock_guard<std::mutex> guard( shard.lock);
+    uint32_t slot;
+    if( !shard.free.empty()) {
+        slot = shard.free.back();
+        shard.free.pop_back();
+    }
+    else {
+        slot = (uint32_t)shard.slots.size();
+        shard.slots.emplace_back();
+    }
+    Session &session = shard.slots[ slot];
+    session.uses++;
+    session.live = true;
+    session.lastUsed = nowMs();
+    uint64_t id = ((uint64_t)session.uses << 32) | (slot * SessionShards + s);
+    session.rng.reseed( seed, id);
+    newGame( session, squaresPerSide);
+    started++;
+    describe( session, id, reply);
+    return id;
+}
+
+
+// The live session with an id, with its shard locked by guard, or NULL if there is none
+Session *SessionTable::lockSession( uint64_t id, std::unique_lock<std::mutex> &guard)
+{
+    uint32_t index = (uint32_t)id;
+    Shard &shard = shards[ index % SessionShards];
+    uint32_t slot = index / SessionShards;
+    guard = std::unique_lock<std::mutex>( shard.lock);
+    if( slot >= shard.slots.size()) {
+        return NULL;
+    }
+    Session &session = shard.slots[ slot];
+    if( !session.live || session.uses != (uint32_t)(id >> 32)) {
+        return NULL;
+    }
+    return &session;
+}
+
+
+long SessionTable::expireIdle( int idleSeconds)
+{
+    int64_t oldest = nowMs() - (int64_t)idleSeconds * 1000;
+    long ended = 0;
+    for( int s=0; s<SessionShards; s++) {
+        // One shard at a time, so commands for the others go on meanwhile
+        std::lock_guard<std::mutex> guard( shards[ s].lock);
+        std::deque<Session> &slots = shards[ s].slots;
+        for( uint32_t slot=0; slot<slots.size(); slot++) {
+            Session &session = slots[ slot];
+            if( session.live && session.lastUsed < oldest) {
+                endSession( session, ((uint64_t)session.uses << 32) | (slot * SessionShards + s));
+                ended++;
+            }
+        }
+    }
+    expired += ended;
+    return ended;
+}
+
+
+// Free a session's slot for the next one, with its shard already locked
+void SessionTable::endSession( Session &session, uint64_t id)
+{
+    uint32_t index = (uint32_t)id;
+    session.live = false;
+    session.history.reset( session.squaresPerSide);   // gives back the memory of its moves
+    shards[ index % SessionShards].free.push_back( index / SessionShards);
+    live--;
+}
+
+
+// Clear the board and place the two starting pieces, as BoardSet does for main()
+void SessionTable::newGame( Session &session, int squaresPerSide)
+{
+    int play[ MaxBoardSize * MaxBoardSize] = { 0 };
+    session.squaresPerSide = (unsigned char)squaresPerSide;
+    session.tile = winningTile( squaresPerSide);
+    session.score = 0;
+    session.move = 1;
+    Random1( play, squaresPerSide, session.rng);
+    Random1( play, squaresPerSide, session.rng);
+    packBoard( session, play);
+    session.history.reset( squaresPerSide);
+    session.history.push( play, session.score, session.move);
+    session.status = (unsigned char)boardKernels( squaresPerSide).gameStatus( play, session.tile);
+}
+
+
+// Carry out one of main()'s commands on a session, as main() does
+void SessionTable::command( Session &session, uint64_t id, char letter, const char *arguments, std::string &reply)
+{
+    int squaresPerSide = session.squaresPerSide;
+    const BoardKernels &kernels = boardKernels( squaresPerSide);
+    int play[ MaxBoardSize * MaxBoardSize];
+    unpackBoard( session, play);
+    int score = session.score;
+    int move = session.move;
+
+    switch( letter) {
+        case 'w':
+        case 'a':
+        case 's':
+        case 'd':
+            if( session.status != GameContinues) {
+                reply = "error the game is over";
+                return;
+            }
+            if( applyMove( kernels, play, letter, score).changed) {
+                // Place a random piece, and keep the new board for undo
+                Random1( play, squaresPerSide, session.rng);
+                move++;
+                session.history.push( play, score, move);
+            }
+            break;
+        case 'u':
+            if( !session.history.pop( play, score, move)) {
+                reply = "error there is no move to undo";
+                return;
+            }
+            break;
+        case 'y':
+            if( !session.history.redo( play, score, move)) {
+                reply = "error there is no undone move to redo";
+                return;
+            }
+            break;
+        case 'r':
+        {
+            int size = parseSize( arguments, squaresPerSide);
+            if( size == 0) {
+                reply = "error the board size must be between 4 and 12";
+                return;
+            }
+            newGame( session, size);
+            describe( session, id, reply);
+            return;
+        }
+        case 'p':
+        {
+            // Tiles are kept as exponents, so only powers of two can be placed
+            int square, value;
+            if( sscanf( arguments, "%d %d", &square, &value) != 2 || square < 0
+                || square >= squaresPerSide * squaresPerSide || !placeableTile( value)) {
+                reply = "error enter p, then the square and a power of two to place there";
+                return;
+            }
+            play[ square] = value;   // does not count as a move
+            break;
+        }
+        default:
+            reply = "error unknown command; use n, w, a, s, d, u, y, r, p or x";
+            return;
+    }
+
+    packBoard( session, play);
+    session.score = score;
+    session.move = move;
+    session.status = (unsigned char)kernels.gameStatus( play, session.tile);
+    describe( session, id, reply);
+}
+
+
+void SessionTable::describe( const Session &session, uint64_t id, std::string &reply) const
+{
+    static const char *statusNames[] = { "playing", "won", "lost" };
+    reply.clear();
+    appendNumber( reply, id);
+    reply += ' ';
+    appendNumber( reply, session.move);
+    reply += ' ';
+    appendNumber( reply, session.score);
+    reply += ' ';
+    reply += statusNames[ session.status];
+    for( int i=0; i<session.squaresPerSide * session.squaresPerSide; i++) {
+        reply += ' ';
+        appendNumber( reply, (session.board[ i] == 0) ? 0 : 1u << session.board[ i]);
+    }
+}
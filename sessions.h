@@ -0,0 +1,114 @@
+//
+// Table of independent game sessions for the game server.
+//
+// Each session is one game: its board, score, move number, winning tile, random
+// generator and undo history, much as main() keeps them for the one game in the window.
+// The board is held as one byte per square (the tile's exponent), and the undo history
+// keeps only the squares each move changed, so a session costs a few hundred bytes plus
+// its recent moves, and a table of many thousands fits easily in memory.
+//
+// Sessions are named by a 64-bit id: the low 32 bits pick a slot in one of the table's
+// shards, and the high bits count how often that slot has been used, so the id of a
+// session that has ended never reaches the one that took its slot.  Each shard has its
+// own lock, so server threads working on different sessions seldom wait for each other.
+//
+// Commands are text lines with the same letters as main()'s keys:
+//
+//   n [SIZE]                 start a new session, SIZE squares per side (default 4)
+//   [ID] w|a|s|d             slide the tiles up, left, down or right
+//   [ID] u|y                 undo or redo a move
+//   [ID] r [SIZE]            start the session's game over, on a board of SIZE (default the same)
+//   [ID] p SQUARE VALUE      place a tile, without it counting as a move
+//   [ID] x                   end the session
+//
+// Without an ID, a command goes to the session last started or named on the connection.
+// Every reply is one line: "ID MOVE SCORE STATUS" followed by the board's tiles, row by
+// row, where STATUS is playing, won or lost; "ID ended SCORE" for x; or "error" and why.
+//
+// A session outlives the connection that started it, so a client can name it again
+// later.  Sessions left without a command for too long are ended by expireIdle().
+//
+#ifndef SESSIONS_H
+#define SESSIONS_H
+
+#include <stdint.h>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "game.h"
+#include "history.h"
+
+const int SessionShards = 64;           // shards of the session table, each with its own lock
+const int SessionHistoryDepth = 100;    // moves each session keeps for undo
+const int DefaultMaxSessions = 100000;
+const int DefaultIdleSeconds = 600;     // time without a command before a session is ended
+
+
+struct Session
+{
+    uint32_t uses;                      // times the slot has been taken, the high half of the id
+    bool live;
+    unsigned char squaresPerSide;
+    unsigned char status;               // GameStatus after the last change to the board
+    int32_t score;
+    int32_t move;
+    int32_t tile;                       // winning tile
+    int64_t lastUsed;                   // steady clock milliseconds at its last command
+    GameRng rng;
+    unsigned char board[ MaxBoardSize * MaxBoardSize];   // tile exponents, 0 for empty
+    UndoHistory history;
+
+    Session() : uses( 0), live( false), squaresPerSide( 0), status( 0), score( 0), move( 0), tile( 0),
+                lastUsed( 0), history( SessionHistoryDepth) {}
+};
+
+
+class SessionTable
+{
+public:
+    // Sessions' random generators are seeded from seed and their ids, so a server
+    // started with the same seed deals the same pieces to the same sessions
+    SessionTable( uint64_t seed, int maxSessions = DefaultMaxSessions);
+
+    // Run one command line and set reply to its answer, without a newline.  current is
+    // the connection's session, 0 for none, which n and a command naming an id change.
+    void execute( const char *line, uint64_t &current, std::string &reply);
+
+    // End every session that has had no command for idleSeconds.  Returns how many
+    // were ended.
+    long expireIdle( int idleSeconds);
+
+    long liveSessions() const { return live.load( std::memory_order_relaxed); }
+    long startedSessions() const { return started.load( std::memory_order_relaxed); }
+    long expiredSessions() const { return expired.load( std::memory_order_relaxed); }
+
+private:
+    struct Shard
+    {
+        std::mutex lock;
+        std::deque<Session> slots;      // a deque, so sessions never move as it grows
+        std::vector<uint32_t> free;     // slots whose session has ended
+    };
+
+    uint64_t startSession( int squaresPerSide, std::string &reply);
+    Session *lockSession( uint64_t id, std::unique_lock<std::mutex> &guard);
+    void endSession( Session &session, uint64_t id);
+    void newGame( Session &session, int squaresPerSide);
+    void command( Session &session, uint64_t id, char letter, const char *arguments, std::string &reply);
+    void describe( const Session &session, uint64_t id, std::string &reply) const;
+
+    uint64_t seed;
+    int maxSessions;
+    Shard shards[ SessionShards];
+    std::atomic<unsigned> nextShard;    // shards are filled in turn
+    std::atomic<long> live;
+    std::atomic<long> started;
+    std::atomic<long> expired;
+
+    SessionTable( const SessionTable &);              // not copyable
+    SessionTable &operator=( const SessionTable &);
+};
+
+#endif
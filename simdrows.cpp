@@ -0,0 +1,359 @@
+//
+// SSE4.1 and AVX2 row kernels for the larger boards.  See simdrows.h.
+//
+#include "simdrows.h"
+
+#if defined( __x86_64__) || defined( __i386__)
+#include <immintrin.h>       // SSE and AVX intrinsics
+#define SIMD_ROWS 1
+#endif
+
+
+#ifdef SIMD_ROWS
+
+#define SSE41_TARGET __attribute__(( target( "sse4.1,popcnt")))
+#define AVX2_TARGET __attribute__(( target( "avx2,popcnt")))
+
+const int LineLength = 16;   // lanes in a line; rows have at most MaxBoardSize squares
+
+// Lines carry extra zero lanes past LineLength, so the load of lane 1 onward and the
+// stores made while compacting stay inside the buffer
+const int LineBuffer = 2 * LineLength;
+
+typedef int (*LineKernel)( int line[], MoveResult &result);
+
+
+//--------------------------------------------------------------------
+// Shuffle tables for compaction, indexed by the mask of non-zero lanes.  Each entry
+// moves the kept lanes to the front, in order.
+alignas( 32) static int permute8[ 256][ 8];          // AVX2 lane indexes for 8 lanes
+alignas( 16) static unsigned char shuffle4[ 16][ 16]; // SSE byte shuffle for 4 lanes, 0x80 clears
+
+static bool buildShuffleTables()
+{
+    for( int mask=0; mask<256; mask++) {
+        int kept = 0;
+        for( int lane=0; lane<8; lane++) {
+            if( mask & (1 << lane)) {
+                permute8[ mask][ kept++] = lane;
+            }
+        }
+        while( kept < 8) {
+            permute8[ mask][ kept++] = 0;   // overwritten by the next chunk or cleared afterwards
+        }
+    }
+    for( int mask=0; mask<16; mask++) {
+        int kept = 0;
+        for( int lane=0; lane<4; lane++) {
+            if( mask & (1 << lane)) {
+                for( int b=0; b<4; b++) {
+                    shuffle4[ mask][ 4*kept + b] = 4*lane + b;
+                }
+                kept++;
+            }
+        }
+        for( int b=4*kept; b<16; b++) {
+            shuffle4[ mask][ b] = 0x80;
+        }
+    }
+    return true;
+}
+
+
+// Given a mask with bit i set when lane i matches lane i+1, pick the pairs that combine.
+// Within each run of matching lanes the 1st, 3rd, ... pairs combine, so that  2 2 2 2
+// (pairs at lanes 0, 1 and 2) becomes  4 4, like Left1.  Adding the start bit of a run
+// clears the run, which marks every run starting on an even lane without a loop.
+static unsigned firstOfPairs( unsigned pairs)
+{
+    unsigned starts = pairs & ~(pairs << 1);
+    unsigned evenStarts = starts & 0x55555555;
+    unsigned evenRuns = ((pairs + evenStarts) ^ pairs) & pairs;
+    return (evenRuns & 0x55555555) | (pairs & ~evenRuns & 0xAAAAAAAA);
+}
+
+
+// Score for the combined tiles: each pair at lane i becomes twice line[ i].  The
+// combined tiles are also recorded in result.
+static int pairScore( const int line[], unsigned merges, MoveResult &result)
+{
+    int score = 0;
+    result.changed = true;
+    result.merged += __builtin_popcount( merges);
+    for( ; merges != 0; merges &= merges - 1) {
+        int made = 2 * line[ __builtin_ctz( merges)];
+        score += made;
+        result.made |= made;
+    }
+    return score;
+}
+
+
+//--------------------------------------------------------------------
+// AVX2: two chunks of eight lanes
+
+// Lanes whose bit is set in the low eight bits of bits
+AVX2_TARGET static inline __m256i laneMask8( unsigned bits)
+{
+    const __m256i laneBits = _mm256_setr_epi32( 1, 2, 4, 8, 16, 32, 64, 128);
+    return _mm256_cmpeq_epi32( _mm256_and_si256( _mm256_set1_epi32( bits), laneBits), laneBits);
+}
+
+
+// Move the non-zero lanes of src to the front of out, clearing the rest.  Returns the
+// mask of non-zero lanes in src.
+AVX2_TARGET static inline unsigned compactAvx2( const int src[], int out[])
+{
+    const __m256i zero = _mm256_setzero_si256();
+    int count = 0;
+    unsigned occupied = 0;
+    for( int chunk=0; chunk<LineLength; chunk+=8) {
+        __m256i tiles = _mm256_loadu_si256( (const __m256i *)(src + chunk));
+        int kept = ~_mm256_movemask_ps( _mm256_castsi256_ps( _mm256_cmpeq_epi32( tiles, zero))) & 0xFF;
+        __m256i order = _mm256_load_si256( (const __m256i *)permute8[ kept]);
+        _mm256_storeu_si256( (__m256i *)(out + count), _mm256_permutevar8x32_epi32( tiles, order));
+        count += _mm_popcnt_u32( kept);
+        occupied |= kept << chunk;
+    }
+    _mm256_storeu_si256( (__m256i *)(out + count), zero);
+    _mm256_storeu_si256( (__m256i *)(out + count + 8), zero);
+    return occupied;
+}
+
+
+AVX2_TARGET static int slideLineAvx2( int line[], MoveResult &result)
+{
+    alignas( 32) int packed[ LineBuffer];
+    unsigned occupied = compactAvx2( line, packed);
+    result.changed |= (occupied & (occupied + 1)) != 0;   // a gap before some tile
+
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i low = _mm256_load_si256( (const __m256i *)packed);
+    __m256i high = _mm256_load_si256( (const __m256i *)(packed + 8));
+    __m256i lowNext = _mm256_loadu_si256( (const __m256i *)(packed + 1));
+    __m256i highNext = _mm256_loadu_si256( (const __m256i *)(packed + 9));
+    __m256i lowPairs = _mm256_andnot_si256( _mm256_cmpeq_epi32( low, zero), _mm256_cmpeq_epi32( low, lowNext));
+    __m256i highPairs = _mm256_andnot_si256( _mm256_cmpeq_epi32( high, zero), _mm256_cmpeq_epi32( high, highNext));
+    unsigned pairs = _mm256_movemask_ps( _mm256_castsi256_ps( lowPairs))
+                   | (_mm256_movemask_ps( _mm256_castsi256_ps( highPairs)) << 8);
+    if( pairs == 0) {
+        compactAvx2( packed, line);
+        return 0;
+    }
+
+    // Double the first tile of each combining pair and clear the second
+    unsigned merges = firstOfPairs( pairs);
+    int score = pairScore( packed, merges, result);
+    unsigned cleared = merges << 1;
+    low = _mm256_add_epi32( low, _mm256_and_si256( low, laneMask8( merges)));
+    high = _mm256_add_epi32( high, _mm256_and_si256( high, laneMask8( merges >> 8)));
+    low = _mm256_andnot_si256( laneMask8( cleared), low);
+    high = _mm256_andnot_si256( laneMask8( cleared >> 8), high);
+    _mm256_store_si256( (__m256i *)packed, low);
+    _mm256_store_si256( (__m256i *)(packed + 8), high);
+    compactAvx2( packed, line);
+    return score;
+}
+
+
+//--------------------------------------------------------------------
+// SSE4.1: four chunks of four lanes
+
+SSE41_TARGET static inline __m128i laneMask4( unsigned bits)
+{
+    const __m128i laneBits = _mm_setr_epi32( 1, 2, 4, 8);
+    return _mm_cmpeq_epi32( _mm_and_si128( _mm_set1_epi32( bits), laneBits), laneBits);
+}
+
+
+SSE41_TARGET static inline unsigned compactSse41( const int src[], int out[])
+{
+    const __m128i zero = _mm_setzero_si128();
+    int count = 0;
+    unsigned occupied = 0;
+    for( int chunk=0; chunk<LineLength; chunk+=4) {
+        __m128i tiles = _mm_loadu_si128( (const __m128i *)(src + chunk));
+        int kept = ~_mm_movemask_ps( _mm_castsi128_ps( _mm_cmpeq_epi32( tiles, zero))) & 0xF;
+        __m128i order = _mm_load_si128( (const __m128i *)shuffle4[ kept]);
+        _mm_storeu_si128( (__m128i *)(out + count), _mm_shuffle_epi8( tiles, order));
+        count += _mm_popcnt_u32( kept);
+        occupied |= kept << chunk;
+    }
+    for( int chunk=0; chunk<LineLength; chunk+=4) {
+        _mm_storeu_si128( (__m128i *)(out + count + chunk), zero);
+    }
+    return occupied;
+}
+
+
+SSE41_TARGET static int slideLineSse41( int line[], MoveResult &result)
+{
+    alignas( 16) int packed[ LineBuffer];
+    unsigned occupied = compactSse41( line, packed);
+    result.changed |= (occupied & (occupied + 1)) != 0;   // a gap before some tile
+
+    const __m128i zero = _mm_setzero_si128();
+    __m128i tiles[ LineLength / 4];
+    unsigned pairs = 0;
+    for( int chunk=0; chunk<LineLength/4; chunk++) {
+        tiles[ chunk] = _mm_load_si128( (const __m128i *)(packed + 4*chunk));
+        __m128i next = _mm_loadu_si128( (const __m128i *)(packed + 4*chunk + 1));
+        __m128i same = _mm_andnot_si128( _mm_cmpeq_epi32( tiles[ chunk], zero), _mm_cmpeq_epi32( tiles[ chunk], next));
+        pairs |= _mm_movemask_ps( _mm_castsi128_ps( same)) << (4*chunk);
+    }
+    if( pairs == 0) {
+        compactSse41( packed, line);
+        return 0;
+    }
+
+    unsigned merges = firstOfPairs( pairs);
+    int score = pairScore( packed, merges, result);
+    unsigned cleared = merges << 1;
+    for( int chunk=0; chunk<LineLength/4; chunk++) {
+        __m128i t = tiles[ chunk];
+        t = _mm_add_epi32( t, _mm_and_si128( t, laneMask4( merges >> (4*chunk))));
+        t = _mm_andnot_si128( laneMask4( cleared >> (4*chunk)), t);
+        _mm_store_si128( (__m128i *)(packed + 4*chunk), t);
+    }
+    compactSse41( packed, line);
+    return score;
+}
+
+
+//--------------------------------------------------------------------
+// Board moves built on a line kernel.  Each row, or each column for the vertical
+// moves, is read into a padded line in the direction of the slide, so the kernel
+// always slides toward lane 0.
+template <int N, int Stride, LineKernel Kernel>
+inline void slideLineVector( int line[], int &score, MoveResult &result)
+{
+    alignas( 32) int buffer[ LineBuffer];
+    for( int i=0; i<N; i++) {
+        buffer[ i] = line[ i*Stride];
+    }
+    for( int i=N; i<LineLength; i++) {
+        buffer[ i] = 0;
+    }
+    score += Kernel( buffer, result);
+    for( int i=0; i<N; i++) {
+        line[ i*Stride] = buffer[ i];
+    }
+}
+
+
+template <int N, LineKernel Kernel>
+MoveResult slideRightVector( int play[], int &score)
+{
+    MoveResult result = { 0, 0, false };
+    for( int row=0; row<N; row++) {
+        slideLineVector<N, -1, Kernel>( play + row*N + N-1, score, result);
+    }
+    return result;
+}
+
+
+template <int N, LineKernel Kernel>
+MoveResult Left1Vector( int game[], int &score)
+{
+    MoveResult result = { 0, 0, false };
+    for( int row=0; row<N; row++) {
+        slideLineVector<N, 1, Kernel>( game + row*N, score, result);
+    }
+    return result;
+}
+
+
+template <int N, LineKernel Kernel>
+MoveResult Up1Vector( int board[], int &score)
+{
+    MoveResult result = { 0, 0, false };
+    for( int col=0; col<N; col++) {
+        slideLineVector<N, N, Kernel>( board + col, score, result);
+    }
+    return result;
+}
+
+
+template <int N, LineKernel Kernel>
+MoveResult Down1Vector( int play[], int &score)
+{
+    MoveResult result = { 0, 0, false };
+    for( int col=0; col<N; col++) {
+        slideLineVector<N, -N, Kernel>( play + (N-1)*N + col, score, result);
+    }
+    return result;
+}
+
+
+template <int N, LineKernel Kernel>
+void setVectorMoves( BoardKernels &kernels)
+{
+    kernels.slideRight = slideRightVector<N, Kernel>;
+    kernels.Left1 = Left1Vector<N, Kernel>;
+    kernels.Up1 = Up1Vector<N, Kernel>;
+    kernels.Down1 = Down1Vector<N, Kernel>;
+}
+
+
+template <LineKernel Kernel>
+bool setVectorMovesForSize( BoardKernels &kernels)
+{
+    switch( kernels.squaresPerSide) {
+        case 8:  setVectorMoves<8, Kernel>( kernels);  return true;
+        case 9:  setVectorMoves<9, Kernel>( kernels);  return true;
+        case 10: setVectorMoves<10, Kernel>( kernels); return true;
+        case 11: setVectorMoves<11, Kernel>( kernels); return true;
+        case 12: setVectorMoves<12, Kernel>( kernels); return true;
+    }
+    return false;
+}
+
+
+static SimdLevel detectSimd()
+{
+    __builtin_cpu_init();
+    if( !__builtin_cpu_supports( "popcnt")) {
+        return SimdNone;
+    }
+    if( __builtin_cpu_supports( "avx2")) {
+        return SimdAvx2;
+    }
+    if( __builtin_cpu_supports( "sse4.1")) {
+        return SimdSse41;
+    }
+    return SimdNone;
+}
+
+#endif // SIMD_ROWS
+
+
+//--------------------------------------------------------------------
+SimdLevel simdSupported()
+{
+#ifdef SIMD_ROWS
+    static SimdLevel level = detectSimd();
+    return level;
+#else
+    return SimdNone;
+#endif
+}
+
+
+bool useSimdRows( BoardKernels &kernels, SimdLevel level)
+{
+#ifdef SIMD_ROWS
+    static bool tablesBuilt = buildShuffleTables();
+    if( !tablesBuilt || level > simdSupported() || kernels.squaresPerSide < SimdMinBoardSize) {
+        return false;
+    }
+    switch( level) {
+        case SimdAvx2:
+            return setVectorMovesForSize<slideLineAvx2>( kernels);
+        case SimdSse41:
+            return setVectorMovesForSize<slideLineSse41>( kernels);
+        case SimdNone:
+            break;
+    }
+#endif
+    return false;
+}
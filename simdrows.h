@@ -0,0 +1,36 @@
+//
+// SSE4.1 and AVX2 row kernels for the larger boards.
+//
+// A row is copied into a zero-padded 16-int line, the non-zero tiles are compacted
+// with a shuffle table indexed by the mask of non-zero lanes, matching neighbours are
+// found with one vector compare, and a second compaction closes the gaps left by the
+// combined tiles.  Vertical moves and slides to the right read the column or the row
+// backwards into the same line, so all four moves use the same kernel.  The result is
+// identical to Left1: each tile combines at most once, so  2 2 4 4  becomes  4 8 0 0.
+//
+#ifndef SIMDROWS_H
+#define SIMDROWS_H
+
+#include "boardkernels.h"
+
+
+// Instruction sets the row kernels can use, in increasing order
+enum SimdLevel
+{
+    SimdNone,
+    SimdSse41,
+    SimdAvx2
+};
+
+// Smallest board on which the vector kernels beat the unrolled scalar loops
+const int SimdMinBoardSize = 8;
+
+// Best level supported by this CPU, detected once
+SimdLevel simdSupported();
+
+// Replace the four move functions in kernels with the vector versions for the given
+// level.  Returns false, leaving kernels unchanged, for SimdNone or boards below
+// SimdMinBoardSize.
+bool useSimdRows( BoardKernels &kernels, SimdLevel level);
+
+#endif
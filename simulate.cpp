@@ -0,0 +1,174 @@
+//
+// Headless game simulation.  See simulate.h.
+//
+#include "simulate.h"
+#include <algorithm>         // For sort
+#include <chrono>            // For steady_clock
+#include <iomanip>           // used for setting output field size using setw
+#include <map>
+#include "game.h"
+#include "boardkernels.h"
+#include "threadpool.h"
+#include "record.h"
+#include "positioncache.h"
+
+
+const char FallbackOrder[] = { 'w', 'a', 's', 'd' };
+
+
+GameResult playGame( int squaresPerSide, MovePolicy &policy, GameRng &rng, GameRecord *pRecord)
+{
+    const BoardKernels &kernels = boardKernels( squaresPerSide);
+    int Tile = winningTile( squaresPerSide);
+    int board[ MaxBoardSize * MaxBoardSize];
+    for( int i=0; i<squaresPerSide * squaresPerSide; i++) {
+        board[ i] = 0;
+    }
+    Random1( board, squaresPerSide, rng);
+    Random1( board, squaresPerSide, rng);
+    if( pRecord != NULL) {
+        pRecord->begin( squaresPerSide, Tile, board);
+    }
+
+    // Track the empty squares and largest tile from the moves, instead of scanning the
+    // board after every move to see whether the game is over
+    BoardSummary summary = kernels.summarize( board);
+    GameResult result = { 0, 0, 0, false };
+    GameStatus status = gameStatusFrom( kernels, board, summary, Tile);
+    while( status == GameContinues) {
+        // Use the policy's choice, or the first other direction that changes the board.
+        // A move that changes nothing leaves the board as it was, so no copy is needed.
+        char direction = policy.chooseMove( board, squaresPerSide, rng);
+        MoveResult move = applyMove( kernels, board, direction, result.score);
+        for( int d=0; d<4 && !move.changed; d++) {
+            direction = FallbackOrder[ d];
+            move = applyMove( kernels, board, direction, result.score);
+        }
+        if( !move.changed) {
+            break;   // not reached: gameStatus only continues while a move is possible
+        }
+        summarizeMove( summary, move);
+        int square = Random1( board, squaresPerSide, rng);
+        summarizeSpawn( summary, board[ square]);
+        if( pRecord != NULL) {
+            pRecord->move( direction, square, board[ square]);
+        }
+        result.moves++;
+        status = gameStatusFrom( kernels, board, summary, Tile);
+    }
+
+    result.maxTile = summary.maxTile;
+    result.won = (status == GameWon);
+    if( pRecord != NULL) {
+        pRecord->end( result.score, result.moves, board);
+    }
+    return result;
+}
+
+
+bool runBatch( const BatchOptions &options, BatchResult &result)
+{
+    ThreadPool pool( options.threads);
+
+    // One policy per worker, plus one for the calling thread, which also plays games
+    std::vector<MovePolicy *> policies;
+    for( int i=0; i<=pool.size(); i++) {
+        MovePolicy *pPolicy = createPolicy( options.policy, &pool, options.moveBudgetMs);
+        if( pPolicy == NULL) {
+            for( size_t p=0; p<policies.size(); p++) {
+                delete policies[ p];
+            }
+            return false;
+        }
+        if( options.pCache != NULL) {
+            pPolicy = new CachedPolicy( pPolicy, *options.pCache);
+        }
+        policies.push_back( pPolicy);
+    }
+
+    result.games.assign( options.games, GameResult());
+    result.threads = pool.size();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    pool.parallelFor( options.games, [&]( int game) {
+        int worker = pool.currentWorker();
+        MovePolicy &policy = *policies[ worker >= 0 ? worker : pool.size()];
+        GameRng rng( options.seed, game);
+        if( options.pRecords != NULL) {
+            GameRecord record;
+            record.setOrigin( options.seed, game);
+            result.games[ game] = playGame( options.squaresPerSide, policy, rng, &record);
+            options.pRecords->write( record);
+        }
+        else {
+            result.games[ game] = playGame( options.squaresPerSide, policy, rng);
+        }
+    });
+    result.seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start).count();
+
+    result.search = SearchStats();
+    for( size_t p=0; p<policies.size(); p++) {
+        policies[ p]->addStats( result.search);
+        delete policies[ p];
+    }
+    return true;
+}
+
+
+void reportBatch( const BatchResult &result, std::ostream &out)
+{
+    int games = (int)result.games.size();
+    if( games == 0) {
+        out << "No games played." << std::endl;
+        return;
+    }
+
+    long moves = 0;
+    long totalScore = 0;
+    int won = 0;
+    std::vector<int> scores;
+    std::map<int, int> maxTiles;   // max tile value -> number of games
+    for( int g=0; g<games; g++) {
+        const GameResult &game = result.games[ g];
+        moves += game.moves;
+        totalScore += game.score;
+        won += game.won;
+        scores.push_back( game.score);
+        maxTiles[ game.maxTile]++;
+    }
+    std::sort( scores.begin(), scores.end());
+
+    out << std::fixed << std::setprecision( 1);
+    out << games << " games on " << result.threads << " threads in " << result.seconds << " s\n";
+    out << "  games/sec: " << games / result.seconds << "\n";
+    out << "  moves/sec: " << moves / result.seconds << "\n";
+    out << "  moves/game: " << (double)moves / games << "\n";
+    out << "  won: " << won << " (" << 100.0 * won / games << "%)\n";
+    out << "Score\n";
+    out << "  mean " << (double)totalScore / games
+        << "  min " << scores.front()
+        << "  p10 " << scores[ games / 10]
+        << "  p50 " << scores[ games / 2]
+        << "  p90 " << scores[ games * 9 / 10]
+        << "  max " << scores.back() << "\n";
+    if( result.search.playouts > 0) {
+        const SearchStats &search = result.search;
+        out << "Rollouts\n";
+        out << "  playouts/sec: " << search.playouts / result.seconds << "\n";
+        out << "  playouts/move: " << (double)search.playouts / (moves > 0 ? moves : 1) << "\n";
+        out << "  moves/playout: " << (double)search.nodes / search.playouts << "\n";
+        out << "  rollout moves/sec: " << search.nodes / result.seconds << "\n";
+    }
+    else if( result.search.nodes > 0) {
+        const SearchStats &search = result.search;
+        out << "Search\n";
+        out << "  nodes/sec: " << search.nodes / result.seconds << "\n";
+        out << "  nodes/move: " << (double)search.nodes / (moves > 0 ? moves : 1) << "\n";
+        out << "  table hit rate: " << 100.0 * search.hits / (search.lookups > 0 ? search.lookups : 1) << "%\n";
+    }
+    out << "Max tile\n";
+    for( std::map<int, int>::const_iterator it = maxTiles.begin(); it != maxTiles.end(); ++it) {
+        out << std::setw( 8) << it->first << std::setw( 8) << it->second
+            << std::setw( 7) << 100.0 * it->second / games << "%\n";
+    }
+    out << std::flush;
+}
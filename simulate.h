@@ -0,0 +1,63 @@
+//
+// Headless game simulation: plays complete games with a move policy, without the
+// window, the console prompts or the pause between moves, and runs batches of games
+// across a work-stealing thread pool.
+//
+#ifndef SIMULATE_H
+#define SIMULATE_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "policy.h"
+#include "rng.h"
+
+class GameRecord;
+class RecordWriter;
+class PositionCache;
+
+
+struct GameResult
+{
+    int score;
+    int moves;       // moves that changed the board
+    int maxTile;
+    bool won;        // reached the winning tile for the board size
+};
+
+
+struct BatchOptions
+{
+    int games;
+    int threads;            // 0 for one per core
+    int squaresPerSide;
+    std::string policy;     // a name accepted by createPolicy
+    double moveBudgetMs;    // time per move for policies that stop on time, 0 for their default
+    unsigned seed;          // game i is seeded from (seed, i), so a batch can be replayed
+    RecordWriter *pRecords; // every game is written here, in the order they finish, unless NULL
+    PositionCache *pCache;  // opening moves are looked up and stored here, unless NULL
+};
+
+
+struct BatchResult
+{
+    std::vector<GameResult> games;
+    double seconds;
+    int threads;
+    SearchStats search;     // totals over all the policy instances
+};
+
+
+// Play one game to the end: the two starting pieces, then a move chosen by the policy
+// and a new piece after every move that changes the board, until gameStatus says stop.
+// If pRecord is not NULL the game is recorded in it.
+GameResult playGame( int squaresPerSide, MovePolicy &policy, GameRng &rng, GameRecord *pRecord = NULL);
+
+// Play options.games games.  Returns false if the policy name is unknown.
+bool runBatch( const BatchOptions &options, BatchResult &result);
+
+// Print games/sec, moves/sec and the score and max tile distributions, and for
+// searching policies nodes/sec and the transposition table hit rate
+void reportBatch( const BatchResult &result, std::ostream &out);
+
+#endif
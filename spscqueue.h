@@ -0,0 +1,55 @@
+//
+// Bounded lock-free queue for one producer thread and one consumer thread.
+//
+// The producer only writes tail and the consumer only writes head, each publishing
+// with a release store what the other reads with an acquire load, so neither side
+// ever waits on a lock or on the other.  A full queue refuses the item instead of
+// blocking.  head and tail sit on separate cache lines so the two threads do not
+// pass one line back and forth on every item.
+//
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+
+
+template <typename T, unsigned Capacity>
+class SpscQueue
+{
+public:
+    SpscQueue() : head( 0), tail( 0) {}
+
+    // Producer only.  Returns false, dropping item, if the queue is full.
+    bool push( const T &item)
+    {
+        unsigned back = tail.load( std::memory_order_relaxed);
+        if( back - head.load( std::memory_order_acquire) == Capacity) {
+            return false;
+        }
+        items[ back % Capacity] = item;
+        tail.store( back + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only.  Returns false if the queue is empty.
+    bool pop( T &item)
+    {
+        unsigned front = head.load( std::memory_order_relaxed);
+        if( front == tail.load( std::memory_order_acquire)) {
+            return false;
+        }
+        item = items[ front % Capacity];
+        head.store( front + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    alignas( 64) std::atomic<unsigned> head;   // next item to pop
+    alignas( 64) std::atomic<unsigned> tail;   // next slot to push into
+    T items[ Capacity];
+
+    SpscQueue( const SpscQueue &);              // not copyable
+    SpscQueue &operator=( const SpscQueue &);
+};
+
+#endif
@@ -0,0 +1,48 @@
+//
+// Non-blocking terminal input for 1024.  See terminal.h.
+//
+#include "terminal.h"
+#include <cctype>            // For isspace()
+#include <poll.h>            // For poll()
+#include <unistd.h>          // For read()
+
+
+TerminalInput::TerminalInput()
+    : ended( false)
+{
+}
+
+
+// Read one character from standard input, waiting at most waitMs, or forever if negative
+bool TerminalInput::character( char &c, int waitMs)
+{
+    if( ended) {
+        // Nothing more will come, but callers still count on the wait to keep from spinning
+        if( waitMs > 0) {
+            poll( NULL, 0, waitMs);
+        }
+        return false;
+    }
+    struct pollfd input = { STDIN_FILENO, POLLIN, 0 };
+    if( poll( &input, 1, waitMs) <= 0) {
+        return false;
+    }
+    if( read( STDIN_FILENO, &c, 1) != 1) {
+        ended = true;
+        return character( c, waitMs);
+    }
+    return true;
+}
+
+
+bool TerminalInput::key( char &c, int waitMs)
+{
+    while( character( c, waitMs)) {
+        if( !isspace( (unsigned char)c)) {
+            return true;
+        }
+        waitMs = 0;   // only wait for the first character
+    }
+    return false;
+}
+
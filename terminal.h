@@ -0,0 +1,29 @@
+//
+// Non-blocking terminal input for 1024.
+//
+// Lets the graphical client take moves typed in the terminal as well as keys pressed
+// in its window, without blocking on std::cin while the window goes unpolled.
+//
+#ifndef TERMINAL_H
+#define TERMINAL_H
+
+
+class TerminalInput
+{
+public:
+    TerminalInput();
+
+    // Next non-space character typed, waiting at most waitMs milliseconds for it.
+    // Returns false if nothing was typed in time, or the input has ended.
+    bool key( char &c, int waitMs);
+
+    // Next character typed, spaces and newlines included, as for the numbers after r
+    // and p, waiting at most waitMs milliseconds for it.  Returns false if nothing was
+    // typed in time, or the input has ended.
+    bool character( char &c, int waitMs);
+
+private:
+    bool ended;      // end of input reached, so stop reading it
+};
+
+#endif
@@ -0,0 +1,204 @@
+//
+// Work-stealing thread pool.  See threadpool.h.
+//
+#include "threadpool.h"
+
+
+// Set for the threads owned by a pool: which pool, and which of its workers
+static thread_local const ThreadPool *pWorkerPool = NULL;
+static thread_local int workerIndex = -1;
+
+
+ThreadPool::ThreadPool( int threads)
+    : queued( 0), stopping( false)
+{
+    if( threads <= 0) {
+        threads = std::thread::hardware_concurrency();
+    }
+    if( threads <= 0) {
+        threads = 1;
+    }
+    for( int i=0; i<threads; i++) {
+        workers.push_back( new Worker);
+    }
+    for( int i=0; i<threads; i++) {
+        workers[ i]->thread = std::thread( &ThreadPool::workerLoop, this, i);
+    }
+}
+
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> guard( sleepLock);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+    for( size_t i=0; i<workers.size(); i++) {
+        workers[ i]->thread.join();
+        delete workers[ i];
+    }
+}
+
+
+int ThreadPool::currentWorker() const
+{
+    return (pWorkerPool == this) ? workerIndex : -1;
+}
+
+
+bool ThreadPool::popOwn( int worker, Task &task)
+{
+    Worker &w = *workers[ worker];
+    std::lock_guard<std::mutex> guard( w.lock);
+    if( w.tasks.empty()) {
+        return false;
+    }
+    task = w.tasks.back();
+    w.tasks.pop_back();
+    queued--;
+    task.pLoop->queued--;
+    return true;
+}
+
+
+// Take the oldest task of some other worker, starting with the next one along
+bool ThreadPool::steal( int thief, Task &task)
+{
+    int count = size();
+    for( int i=1; i<=count; i++) {
+        Worker &victim = *workers[ (thief + i + count) % count];
+        std::lock_guard<std::mutex> guard( victim.lock);
+        if( !victim.tasks.empty()) {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+            queued--;
+            task.pLoop->queued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+bool ThreadPool::findTask( int worker, Task &task)
+{
+    if( queued == 0) {
+        return false;
+    }
+    if( worker >= 0 && popOwn( worker, task)) {
+        return true;
+    }
+    return steal( worker < 0 ? 0 : worker, task);
+}
+
+
+// A task of one parallelFor call, for the thread waiting on it.  A worker's call put its
+// tasks on its own queue, where they are the newest ones but for any that a call from
+// outside the pool dealt out since.  A call from outside the pool dealt its tasks out
+// over every queue, behind the ones already there.
+bool ThreadPool::findLoopTask( int worker, const Loop &loop, Task &task)
+{
+    if( loop.queued == 0) {
+        return false;
+    }
+    int first = (worker >= 0) ? worker : 0;
+    int last = (worker >= 0) ? worker : size() - 1;
+    for( int i=first; i<=last; i++) {
+        Worker &w = *workers[ i];
+        std::lock_guard<std::mutex> guard( w.lock);
+        std::deque<Task>::iterator found = w.tasks.end();
+        if( worker >= 0) {
+            // Newest first
+            for( std::deque<Task>::iterator t=w.tasks.end(); t!=w.tasks.begin(); ) {
+                if( (--t)->pLoop == &loop) {
+                    found = t;
+                    break;
+                }
+            }
+        }
+        else {
+            // Oldest first
+            for( found=w.tasks.begin(); found!=w.tasks.end() && found->pLoop!=&loop; ++found) {
+            }
+        }
+        if( found != w.tasks.end()) {
+            task = *found;
+            w.tasks.erase( found);
+            queued--;
+            task.pLoop->queued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+void ThreadPool::runTask( const Task &task)
+{
+    (*task.pBody)( task.index);
+    if( --task.pLoop->remaining == 0) {
+        // Take the lock so a thread that just checked the count is already waiting
+        std::lock_guard<std::mutex> guard( sleepLock);
+        wakeUp.notify_all();
+    }
+}
+
+
+void ThreadPool::workerLoop( int worker)
+{
+    pWorkerPool = this;
+    workerIndex = worker;
+    Task task;
+    while( true) {
+        if( findTask( worker, task)) {
+            runTask( task);
+            continue;
+        }
+        std::unique_lock<std::mutex> guard( sleepLock);
+        if( stopping) {
+            return;
+        }
+        if( queued == 0) {
+            wakeUp.wait( guard);
+        }
+    }
+}
+
+
+void ThreadPool::parallelFor( int count, const std::function<void( int)> &body)
+{
+    if( count <= 0) {
+        return;
+    }
+    Loop loop( count);
+
+    // Tasks go to the caller's own queue when it is a worker, so idle workers steal
+    // them; otherwise they are dealt out across all the queues.
+    int self = currentWorker();
+    for( int i=0; i<count; i++) {
+        Task task = { &body, i, &loop };
+        Worker &w = *workers[ self >= 0 ? self : i % size()];
+        std::lock_guard<std::mutex> guard( w.lock);
+        w.tasks.push_back( task);
+        queued++;
+    }
+    {
+        std::lock_guard<std::mutex> guard( sleepLock);
+        wakeUp.notify_all();
+    }
+
+    // Help with this loop's tasks until every one has finished.  Once the others have
+    // all been taken, wait for the threads running them.
+    Task task;
+    while( loop.remaining > 0) {
+        if( findLoopTask( self, loop, task)) {
+            runTask( task);
+            continue;
+        }
+        std::unique_lock<std::mutex> guard( sleepLock);
+        if( loop.remaining > 0) {
+            wakeUp.wait( guard);
+        }
+    }
+}
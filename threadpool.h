@@ -0,0 +1,83 @@
+//
+// Work-stealing thread pool.
+//
+// Each worker owns a queue of tasks.  A worker takes tasks from the back of its own
+// queue and, when that is empty, steals from the front of another worker's queue, so
+// uneven tasks (such as games of very different lengths) keep every core busy.
+// parallelFor() may be called from inside a task; the waiting thread runs the queued
+// tasks of its own call instead of blocking, so nested parallel loops cannot deadlock.
+// It never runs anyone else's tasks while it waits.  If it did, another game could start
+// on a thread that is partway through a game, and share that thread's per-worker
+// state.
+//
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+class ThreadPool
+{
+public:
+    // threads of 0 uses one thread per hardware core
+    explicit ThreadPool( int threads = 0);
+    ~ThreadPool();
+
+    int size() const { return (int)workers.size(); }
+
+    // Run body( i) for every i in [0, count) and return once all have finished.
+    // The calling thread runs this call's tasks too while it waits.
+    void parallelFor( int count, const std::function<void( int)> &body);
+
+    // Index of this pool's worker running the caller, or -1 for any other thread,
+    // including the workers of other pools
+    int currentWorker() const;
+
+private:
+    // One call of parallelFor
+    struct Loop
+    {
+        std::atomic<int> remaining;     // tasks still to finish
+        std::atomic<int> queued;        // tasks not yet taken from a queue
+
+        explicit Loop( int count) : remaining( count), queued( count) {}
+    };
+
+    struct Task
+    {
+        const std::function<void( int)> *pBody;
+        int index;
+        Loop *pLoop;
+    };
+
+    struct Worker
+    {
+        std::mutex lock;
+        std::deque<Task> tasks;
+        std::thread thread;
+    };
+
+    bool popOwn( int worker, Task &task);
+    bool steal( int thief, Task &task);
+    bool findTask( int worker, Task &task);
+    bool findLoopTask( int worker, const Loop &loop, Task &task);
+    void runTask( const Task &task);
+    void workerLoop( int worker);
+
+    std::vector<Worker *> workers;
+    std::atomic<int> queued;          // tasks waiting in any queue
+    std::mutex sleepLock;             // guards sleeping on wakeUp
+    std::condition_variable wakeUp;   // signalled when tasks arrive or a loop finishes
+    bool stopping;
+
+    ThreadPool( const ThreadPool &);              // not copyable
+    ThreadPool &operator=( const ThreadPool &);
+};
+
+#endif